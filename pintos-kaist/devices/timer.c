@@ -7,6 +7,8 @@
 #include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,17 +19,55 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency, and the counter value that divides it
+   down to TIMER_FREQ, rounded to nearest. */
+#define PIT_HZ 1193180
+#define TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks a single one-shot count can span. */
+#define ONESHOT_MAX_TICKS (0xffff / TICK_COUNT)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Dynamic-tick mode, set by the kernel command-line option
+   -tickless.  See timer_idle(). */
+bool timer_tickless;
+
+/* One-shot state.  While ONESHOT_TICKS is nonzero the PIT is in
+   mode 0 and its next interrupt ends tick ticks + ONESHOT_TICKS;
+   ONESHOT_COUNT counts were programmed, of which the first
+   ONESHOT_FIRST finish the tick that was in progress. */
+static int64_t oneshot_ticks;
+static uint16_t oneshot_count;
+static uint16_t oneshot_first;
+
+/* Number of one-shot waits and of periodic ticks they avoided. */
+static int64_t oneshot_waits;
+static int64_t ticks_skipped;
+
+/* Number of timer interrupts handled and TSC cycles spent in
+   the timer interrupt handler, for measuring its cost. */
+static int64_t isr_count;
+static uint64_t isr_cycles;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Wakes up sleeping threads after the timer interrupt returns. */
+static struct work wakeup_work;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void pit_periodic (void);
+static void pit_oneshot (uint16_t count);
+static bool pit_read (uint16_t *count);
+static void catch_up (int64_t cnt);
+static void queue_wakeup (void);
+static work_func wake_sleepers;
 
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
@@ -35,14 +75,8 @@ static void real_time_sleep (int64_t num, int32_t denom);
    corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
-
+	work_init (&wakeup_work, wake_sleepers, NULL);
+	pit_periodic ();
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -116,23 +150,174 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Waits for the next interrupt on behalf of the idle thread,
+   which calls this with interrupts off.  Returns with interrupts
+   on.
+
+   Normally this just halts until the next periodic tick.  In
+   tickless mode, if no sleeping thread is due on the next tick,
+   it stops the periodic tick and programs the PIT to interrupt
+   once, at the tick boundary of the earliest sleeper deadline (or
+   as far ahead as the 16-bit counter reaches).  If another
+   interrupt wakes the CPU first, the ticks that already passed
+   are accounted for and the PIT is set to resume periodic
+   operation at the next tick boundary, so that the thread that
+   was woken sees an up-to-date timer_ticks() and is preempted as
+   usual. */
+void
+timer_idle (void) {
+	uint16_t remaining;
+	int64_t delta;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	delta = thread_next_wakeup () - ticks;
+	if (!timer_tickless || delta <= 1 || ONESHOT_MAX_TICKS < 2
+			|| !pit_read (&remaining)) {
+		asm volatile ("sti; hlt" : : : "memory");
+		return;
+	}
+
+	/* Finish the current tick, then run DELTA - 1 more. */
+	if (delta > ONESHOT_MAX_TICKS)
+		delta = ONESHOT_MAX_TICKS;
+	oneshot_first = remaining;
+	oneshot_ticks = delta;
+	pit_oneshot (remaining + (delta - 1) * TICK_COUNT);
+	oneshot_waits++;
+
+	asm volatile ("sti; hlt" : : : "memory");
+
+	/* If the one-shot interrupt did not fire, some other interrupt
+	   woke us.  Catch up on the ticks that passed and end the
+	   one-shot at the next tick boundary. */
+	intr_disable ();
+	if (oneshot_ticks > 0 && pit_read (&remaining)) {
+		int elapsed = oneshot_count - remaining;
+		int passed = 0;
+		int left;
+
+		if (elapsed < oneshot_first)
+			left = oneshot_first - elapsed;
+		else {
+			passed = 1 + (elapsed - oneshot_first) / TICK_COUNT;
+			left = TICK_COUNT - (elapsed - oneshot_first) % TICK_COUNT;
+		}
+		catch_up (passed);
+		oneshot_first = left;
+		oneshot_ticks = 1;
+		pit_oneshot (left);
+	}
+	intr_enable ();
+}
+
+/* Returns the number of timer interrupts handled so far and
+   stores the total TSC cycles spent handling them in *CYCLES. */
+int64_t
+timer_isr_stats (uint64_t *cycles) {
+	enum intr_level old_level = intr_disable ();
+	int64_t cnt = isr_count;
+	*cycles = isr_cycles;
+	intr_set_level (old_level);
+	return cnt;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) {
-	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+	uint64_t cycles;
+	int64_t cnt = timer_isr_stats (&cycles);
+
+	printf ("Timer: %"PRId64" ticks, %"PRIu64" cycles per interrupt\n",
+			timer_ticks (), cnt > 0 ? cycles / cnt : 0);
+	if (timer_tickless)
+		printf ("Timer: %"PRId64" one-shot idle waits, %"PRId64" ticks skipped\n",
+				oneshot_waits, ticks_skipped);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
+	uint64_t start = rdtsc ();
+
+	/* End of a one-shot idle wait: account for every tick but the
+	   last, which is handled below, and resume periodic ticks. */
+	if (oneshot_ticks > 0) {
+		catch_up (oneshot_ticks - 1);
+		oneshot_ticks = 0;
+		pit_periodic ();
+	}
+
 	ticks++;
 	thread_tick ();  // update the cpu usage for running process
-	wake_up(ticks);
+	queue_wakeup ();
+
+	isr_cycles += rdtsc () - start;
+	isr_count++;
+}
+
 
-	// update global tick
+/* Advances the tick count by CNT ticks that passed without a
+   timer interrupt while the CPU was idle, and arranges to wake up
+   any thread that became due.  Interrupts must be off. */
+static void
+catch_up (int64_t cnt) {
+	if (cnt <= 0)
+		return;
+	ticks += cnt;
+	ticks_skipped += cnt;
+	thread_idle_ticks (cnt);
+	queue_wakeup ();
+}
+
+/* Has deferred work wake up the threads that are due by now, if
+   any, so that the timer interrupt itself stays short.  Interrupts
+   must be off. */
+static void
+queue_wakeup (void) {
+	if (thread_next_wakeup () <= ticks)
+		work_queue (&wakeup_work, WORK_HIGH);
 }
 
+/* Wakes up every sleeping thread that is due. */
+static void
+wake_sleepers (void *aux UNUSED) {
+	wake_up (timer_ticks ());
+}
 
+/* Programs PIT counter 0 to interrupt TIMER_FREQ times per
+   second. */
+static void
+pit_periodic (void) {
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, TICK_COUNT & 0xff);
+	outb (0x40, TICK_COUNT >> 8);
+}
+
+/* Programs PIT counter 0 to interrupt once, COUNT input clocks
+   from now. */
+static void
+pit_oneshot (uint16_t count) {
+	oneshot_count = count;
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Reads the current value of PIT counter 0 into *COUNT.  Returns
+   false if the counter has reached its terminal count in mode 0,
+   meaning that its interrupt is already pending. */
+static bool
+pit_read (uint16_t *count) {
+	uint8_t status, lo, hi;
+
+	outb (0x43, 0xc2);    /* Read-back: latch count and status, counter 0. */
+	status = inb (0x40);
+	lo = inb (0x40);
+	hi = inb (0x40);
+	*count = lo | (hi << 8);
+	return !(status & 0x80) || (status & 0x0e) != 0;
+}
 
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
@@ -5,7 +5,10 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -53,10 +56,35 @@ byte_to_sector (const struct inode *inode, off_t pos) {
  * returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes.  Opening an inode that is already open
+ * only searches the list, so it takes the lock for reading;
+ * adding and removing inodes take it for writing. */
+static struct rwlock open_inodes_lock;
+
+/* Cache of in-memory inodes. */
+static struct slab_cache *inode_cache;
+
 /* Initializes the inode module. */
 void
 inode_init (void) {
+	inode_cache = slab_cache_create ("inode", sizeof (struct inode), NULL);
 	list_init (&open_inodes);
+	rwlock_init (&open_inodes_lock);
+}
+
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+ * if it is not open.  OPEN_INODES_LOCK must be held. */
+static struct inode *
+find_open_inode (disk_sector_t sector) {
+	struct list_elem *e;
+
+	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+			e = list_next (e)) {
+		struct inode *inode = list_entry (e, struct inode, elem);
+		if (inode->sector == sector)
+			return inode_reopen (inode);
+	}
+	return NULL;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -101,23 +129,31 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
 	struct inode *inode;
+	struct rw_hold hold;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	rwlock_acquire_read (&open_inodes_lock, &hold);
+	inode = find_open_inode (sector);
+	rwlock_release_read (&open_inodes_lock, &hold);
+	if (inode != NULL)
+		return inode;
+
+	/* Check again for writing, in case someone else opened it in
+	 * the meantime. */
+	rwlock_acquire_write (&open_inodes_lock);
+	inode = find_open_inode (sector);
+	if (inode != NULL) {
+		rwlock_release_write (&open_inodes_lock);
+		return inode;
 	}
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	inode = slab_alloc (inode_cache);
+	if (inode == NULL) {
+		rwlock_release_write (&open_inodes_lock);
 		return NULL;
+	}
 
 	/* Initialize. */
 	list_push_front (&open_inodes, &inode->elem);
@@ -126,14 +162,20 @@ inode_open (disk_sector_t sector) {
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
 	disk_read (filesys_disk, inode->sector, &inode->data);
+	rwlock_release_write (&open_inodes_lock);
 	return inode;
 }
 
-/* Reopens and returns INODE. */
+/* Reopens and returns INODE.  May be called by several readers of
+ * OPEN_INODES_LOCK at once, so the count is updated with
+ * interrupts off. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		enum intr_level old_level = intr_disable ();
 		inode->open_cnt++;
+		intr_set_level (old_level);
+	}
 	return inode;
 }
 
@@ -153,9 +195,14 @@ inode_close (struct inode *inode) {
 		return;
 
 	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
+	rwlock_acquire_write (&open_inodes_lock);
+	enum intr_level old_level = intr_disable ();
+	int open_cnt = --inode->open_cnt;
+	intr_set_level (old_level);
+	if (open_cnt == 0) {
 		/* Remove from inode list and release lock. */
 		list_remove (&inode->elem);
+		rwlock_release_write (&open_inodes_lock);
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
@@ -164,8 +211,9 @@ inode_close (struct inode *inode) {
 					bytes_to_sectors (inode->data.length)); 
 		}
 
-		free (inode); 
-	}
+		slab_free (inode_cache, inode);
+	} else
+		rwlock_release_write (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
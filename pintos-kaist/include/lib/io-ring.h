@@ -0,0 +1,93 @@
+#ifndef __LIB_IO_RING_H
+#define __LIB_IO_RING_H
+
+/* Shared submission and completion rings for asynchronous system
+   calls, in the manner of Linux's io_uring.
+
+   io_ring_setup() maps a ring into the calling process.  The
+   process queues operations as submission queue entries (SQEs)
+   and the kernel answers each one with a completion queue entry
+   (CQE) carrying the result the equivalent system call would
+   have returned.  Either io_ring_enter() consumes the queued
+   SQEs, many per trap, or, with IO_RING_SQPOLL, a kernel thread
+   polls for them and the process need not trap at all.
+
+   Each queue is an array of a power-of-2 number of entries,
+   indexed by free-running 32-bit head and tail counters: the
+   producer fills the entry at the tail and then advances the
+   tail, and the consumer reads the entry at the head and then
+   advances the head.  The process produces SQEs and consumes
+   CQEs; the kernel does the reverse. */
+
+#include <stdint.h>
+
+/* Largest number of SQEs in a ring. */
+#define IO_RING_MAX_ENTRIES 256
+
+/* io_ring_setup() flags. */
+#define IO_RING_SQPOLL 0x1          /* A kernel thread polls the SQ. */
+
+/* Bits in struct io_ring's flags, set by the kernel. */
+#define IO_RING_NEED_WAKEUP 0x1     /* Poller sleeps: call io_ring_enter(). */
+
+/* Operations. */
+enum io_ring_op {
+	IO_RING_NOP,                    /* Completes with 0. */
+	IO_RING_READ,                   /* read(), or at OFF if OFF >= 0. */
+	IO_RING_WRITE,                  /* write(), or at OFF if OFF >= 0. */
+	IO_RING_OPEN,                   /* open() of the file named at ADDR. */
+	IO_RING_CLOSE,                  /* close(). */
+};
+
+/* Submission queue entry. */
+struct io_sqe {
+	uint8_t op;                     /* An enum io_ring_op. */
+	int32_t fd;                     /* File descriptor. */
+	uint64_t addr;                  /* Buffer or file name. */
+	uint32_t len;                   /* Buffer length. */
+	int32_t off;                    /* File offset, or -1. */
+	uint64_t user_data;             /* Copied into the completion. */
+};
+
+/* Completion queue entry. */
+struct io_cqe {
+	uint64_t user_data;             /* From the submission. */
+	int32_t res;                    /* Result of the operation. */
+};
+
+/* Ring header, at the start of the mapping.  SQ_ENTRIES SQEs
+   follow it, then CQ_ENTRIES CQEs.  The kernel keeps its own copy
+   of everything but the process's head and tail counters, so a
+   process that scribbles here only hurts itself. */
+struct io_ring {
+	uint32_t sq_head;               /* Kernel: next SQE to consume. */
+	uint32_t sq_tail;               /* Process: end of published SQEs. */
+	uint32_t cq_head;               /* Process: next CQE to reap. */
+	uint32_t cq_tail;               /* Kernel: end of posted CQEs. */
+	uint32_t sq_entries;            /* Number of SQEs. */
+	uint32_t cq_entries;            /* Number of CQEs, 2 * sq_entries. */
+	uint32_t setup_flags;           /* Flags passed to io_ring_setup(). */
+	uint32_t flags;                 /* IO_RING_NEED_WAKEUP. */
+	uint32_t sq_fill;               /* Process: SQEs filled, unpublished. */
+};
+
+/* Returns RING's array of SQEs. */
+static inline struct io_sqe *
+io_ring_sqes (struct io_ring *ring) {
+	return (struct io_sqe *) (ring + 1);
+}
+
+/* Returns RING's array of CQEs, given its number of SQEs. */
+static inline struct io_cqe *
+io_ring_cqes (struct io_ring *ring, uint32_t sq_entries) {
+	return (struct io_cqe *) (io_ring_sqes (ring) + sq_entries);
+}
+
+/* Returns the size in bytes of a ring with SQ_ENTRIES SQEs. */
+static inline uint64_t
+io_ring_size (uint32_t sq_entries) {
+	return sizeof (struct io_ring) + sq_entries * sizeof (struct io_sqe)
+		+ 2 * sq_entries * sizeof (struct io_cqe);
+}
+
+#endif /* lib/io-ring.h */
@@ -0,0 +1,60 @@
+#ifndef __LIB_KERNEL_PQUEUE_H
+#define __LIB_KERNEL_PQUEUE_H
+
+/* Intrusive priority queue.
+ *
+ * A max-priority queue of elements keyed by an int, implemented
+ * as a pairing heap.  Like struct list, it needs no dynamic
+ * memory: each structure that can be queued embeds a struct
+ * pq_elem, and pq_entry() converts an element back into the
+ * structure that contains it.  The queue itself is only a root
+ * pointer and a couple of counters, so it is cheap to embed in
+ * every semaphore.
+ *
+ * Elements with equal keys come out in the order they were
+ * pushed.  An element's key can be changed in place with
+ * pq_rekey(), for example when a waiting thread receives a
+ * priority donation, without disturbing that order.
+ *
+ * Costs: pq_push(), pq_max() and raising a key are O(1); pq_pop()
+ * and pq_remove() are O(log n) amortized.  No operation walks or
+ * sorts the whole queue.
+ *
+ * Like struct list, the queue does no locking. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Priority queue element. */
+struct pq_elem {
+	struct pq_elem *child;      /* First child. */
+	struct pq_elem *next;       /* Next sibling. */
+	struct pq_elem *prev;       /* Previous sibling, or parent if first. */
+	int key;                    /* Larger keys come out first. */
+	uint64_t seq;               /* Push order, to break ties. */
+};
+
+/* Priority queue. */
+struct pqueue {
+	struct pq_elem *root;       /* Element with the largest key. */
+	size_t size;                /* Number of elements. */
+	uint64_t next_seq;          /* Sequence number for the next push. */
+};
+
+/* Converts pointer to priority queue element PQ_ELEM into a
+   pointer to the structure that PQ_ELEM is embedded inside. */
+#define pq_entry(PQ_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) (PQ_ELEM)              \
+		- offsetof (STRUCT, MEMBER)))
+
+void pq_init (struct pqueue *);
+void pq_push (struct pqueue *, struct pq_elem *, int key);
+struct pq_elem *pq_max (struct pqueue *);
+struct pq_elem *pq_pop (struct pqueue *);
+void pq_remove (struct pqueue *, struct pq_elem *);
+void pq_rekey (struct pqueue *, struct pq_elem *, int key);
+bool pq_empty (const struct pqueue *);
+size_t pq_size (const struct pqueue *);
+
+#endif /* lib/kernel/pqueue.h */
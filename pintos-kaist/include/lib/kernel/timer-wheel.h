@@ -0,0 +1,60 @@
+#ifndef __LIB_KERNEL_TIMER_WHEEL_H
+#define __LIB_KERNEL_TIMER_WHEEL_H
+
+/* Hierarchical timing wheel.
+ *
+ * Keeps a set of elements keyed by an expiry time (in ticks) so
+ * that insertion is O(1) and advancing the clock by one tick is
+ * O(1) amortized, no matter how many elements are pending.
+ *
+ * Level 0 has one slot per tick for the next TW_SLOTS ticks.
+ * Each higher level has TW_SLOTS slots that each cover TW_SLOTS
+ * times as many ticks as a slot one level down.  When the clock
+ * crosses a slot boundary of a higher level, that slot's elements
+ * are "cascaded" down into the lower levels.  Elements that are
+ * too far in the future for the top level wait on an overflow
+ * list that is redistributed each time the top level wraps.
+ *
+ * Like struct list, the wheel does no locking; the owner must
+ * provide mutual exclusion (thread.c does so by disabling
+ * interrupts and holding a spin lock). */
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TW_SLOT_BITS 6                  /* log2 of slots per level. */
+#define TW_SLOTS (1 << TW_SLOT_BITS)    /* Slots per level. */
+#define TW_LEVELS 4                     /* Number of levels. */
+
+/* Wheel element.  Embed this in the structure to be timed. */
+struct timer_wheel_elem {
+	struct list_elem elem;      /* Slot list element. */
+	int64_t expires;            /* Tick at which the element expires. */
+};
+
+/* Timing wheel. */
+struct timer_wheel {
+	int64_t now;                /* Next tick to be processed. */
+	size_t cnt;                 /* Number of pending elements. */
+	struct list slots[TW_LEVELS][TW_SLOTS];
+	struct list overflow;       /* Beyond the range of the top level. */
+};
+
+/* Converts pointer to wheel element TW_ELEM into a pointer to the
+   structure that TW_ELEM is embedded inside. */
+#define timer_wheel_entry(TW_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) &(TW_ELEM)->elem                 \
+		- offsetof (STRUCT, MEMBER.elem)))
+
+void timer_wheel_init (struct timer_wheel *, int64_t now);
+void timer_wheel_insert (struct timer_wheel *, struct timer_wheel_elem *,
+		int64_t expires);
+void timer_wheel_remove (struct timer_wheel *, struct timer_wheel_elem *);
+void timer_wheel_advance (struct timer_wheel *, int64_t now,
+		struct list *expired);
+int64_t timer_wheel_next_expiry (const struct timer_wheel *);
+bool timer_wheel_empty (const struct timer_wheel *);
+
+#endif /* lib/kernel/timer-wheel.h */
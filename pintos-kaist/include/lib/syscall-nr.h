@@ -36,6 +36,22 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Futexes. */
+	SYS_FUTEX_WAIT,             /* Sleep while a user word holds a value. */
+	SYS_FUTEX_WAKE,             /* Wake threads sleeping on a user word. */
+
+	/* Scheduling. */
+	SYS_SCHED_DEADLINE,         /* Enter or leave the deadline class. */
+
+	/* Threads. */
+	SYS_THREAD_CREATE,          /* Start a thread in this process. */
+	SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+	SYS_THREAD_EXIT,            /* Terminate this thread. */
+
+	/* Asynchronous system calls. */
+	SYS_IO_RING_SETUP,          /* Map a submission/completion ring. */
+	SYS_IO_RING_ENTER,          /* Submit to and wait on the ring. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,40 @@
+#ifndef __LIB_USER_MUTEX_H
+#define __LIB_USER_MUTEX_H
+
+/* User-space mutexes and condition variables built on futexes.
+
+   Both are plain ints in user memory.  Taking or releasing a
+   mutex nobody else wants, and signaling a condition nobody
+   waits on, never enter the kernel; only a thread that actually
+   has to sleep, or has to wake a sleeper, makes a system call.
+
+   Neither needs to be destroyed. */
+
+#include <stdbool.h>
+
+/* Mutex. */
+struct mutex {
+	int state;                  /* 0: free, 1: held, 2: held, contended. */
+};
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable. */
+struct condvar {
+	int seq;                    /* Bumped by every signal. */
+	int waiters;                /* Threads in condvar_wait(). */
+};
+
+#define CONDVAR_INITIALIZER { 0, 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *, struct mutex *);
+void condvar_broadcast (struct condvar *, struct mutex *);
+
+#endif /* lib/user/mutex.h */
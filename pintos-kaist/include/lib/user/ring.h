@@ -0,0 +1,66 @@
+#ifndef __LIB_USER_RING_H
+#define __LIB_USER_RING_H
+
+/* Helpers for the asynchronous system call rings of <io-ring.h>.
+
+   Get an SQE with io_ring_get_sqe(), fill it with one of the
+   io_ring_prep_*() functions, repeat, and then publish them all
+   with io_ring_submit().  Reap completions with
+   io_ring_peek_cqe() and io_ring_cqe_seen().  With a polled ring
+   (IO_RING_SQPOLL), io_ring_submit() makes a system call only if
+   the kernel's poller has gone to sleep or the caller asks to
+   wait.
+
+   A ring is not safe to use from several threads at once. */
+
+#include <io-ring.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct io_sqe *io_ring_get_sqe (struct io_ring *);
+int io_ring_submit (struct io_ring *, unsigned wait_nr);
+struct io_cqe *io_ring_peek_cqe (struct io_ring *);
+void io_ring_cqe_seen (struct io_ring *);
+
+/* Fills SQE with the given operation and arguments. */
+static inline void
+io_ring_prep (struct io_sqe *sqe, enum io_ring_op op, int fd,
+		const void *addr, unsigned len, int off) {
+	sqe->op = op;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t) addr;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->user_data = 0;
+}
+
+static inline void
+io_ring_prep_nop (struct io_sqe *sqe) {
+	io_ring_prep (sqe, IO_RING_NOP, -1, NULL, 0, -1);
+}
+
+/* Reads LEN bytes at offset OFF, or at the file position if OFF
+   is -1. */
+static inline void
+io_ring_prep_read (struct io_sqe *sqe, int fd, void *buf, unsigned len,
+		int off) {
+	io_ring_prep (sqe, IO_RING_READ, fd, buf, len, off);
+}
+
+static inline void
+io_ring_prep_write (struct io_sqe *sqe, int fd, const void *buf,
+		unsigned len, int off) {
+	io_ring_prep (sqe, IO_RING_WRITE, fd, buf, len, off);
+}
+
+static inline void
+io_ring_prep_open (struct io_sqe *sqe, const char *file) {
+	io_ring_prep (sqe, IO_RING_OPEN, -1, file, 0, -1);
+}
+
+static inline void
+io_ring_prep_close (struct io_sqe *sqe, int fd) {
+	io_ring_prep (sqe, IO_RING_CLOSE, fd, NULL, 0, -1);
+}
+
+#endif /* lib/user/ring.h */
@@ -38,6 +38,28 @@ void close (int fd);
 
 int dup2(int oldfd, int newfd);
 
+/* Futexes. */
+int futex_wait (int *addr, int val);
+int futex_wake (int *addr, int cnt);
+
+/* Scheduling.  Times are in timer ticks. */
+bool sched_deadline (int runtime, int deadline, int period);
+
+/* Threads.  A thread shares its process's memory and open files,
+   and runs on a stack of its own.  Returning from the thread
+   function is the same as calling thread_exit() with the value
+   returned.  exit() in any thread ends the whole process. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+typedef int thread_func (void *aux);
+tid_t thread_create (thread_func *, void *aux);
+int thread_join (tid_t);
+void thread_exit (int status) NO_RETURN;
+
+/* Asynchronous system calls; see <io-ring.h> and <ring.h>. */
+struct io_ring *io_ring_setup (unsigned entries, unsigned flags);
+int io_ring_enter (unsigned to_submit, unsigned min_complete);
+
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
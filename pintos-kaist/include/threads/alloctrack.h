@@ -0,0 +1,32 @@
+#ifndef THREADS_ALLOCTRACK_H
+#define THREADS_ALLOCTRACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Allocators whose calls are tracked. */
+enum alloc_kind {
+	ALLOC_MALLOC,               /* malloc(), calloc(), realloc(). */
+	ALLOC_PALLOC,               /* palloc_get_page(), palloc_get_multiple(). */
+};
+
+#ifdef ALLOC_TRACK
+/* True to track allocations.  Set by -alloctrack. */
+extern bool alloc_track;
+
+void alloc_track_init (void);
+void alloc_track_alloc (enum alloc_kind, const void *caller,
+		const void *ptr, size_t size);
+void alloc_track_free (const void *ptr);
+
+/* Runs STMT if the allocation tracker is on.  Without ALLOC_TRACK
+   the tracker is not compiled in at all. */
+#define ALLOC_TRACK_DO(STMT) do { if (alloc_track) { STMT; } } while (0)
+#else
+#define alloc_track_init() ((void) 0)
+#define ALLOC_TRACK_DO(STMT) ((void) 0)
+#endif
+
+void alloc_track_print (void);
+
+#endif /* threads/alloctrack.h */
@@ -0,0 +1,75 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <pqueue.h>
+#include <stdint.h>
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+
+/* Maximum number of CPUs. */
+#define CPU_MAX 16
+
+/* Number of priority levels, one run queue each. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+
+/* Maximum number of thread pages cached per CPU. */
+#define THREAD_CACHE_MAX 8
+
+/* Per-CPU data.
+
+   Each CPU has its own run queue: one FIFO list per priority
+   level, and bit N of ready_mask is set exactly when
+   ready_queues[N] is nonempty, so the highest-priority ready
+   thread is found with a single bit scan.  A CPU whose queue runs
+   dry runs its idle thread. */
+struct cpu {
+	unsigned id;                        /* CPU number; 0 is the boot CPU. */
+	struct thread *idle_thread;         /* Runs when nothing else is ready. */
+
+	/* Run queue, protected by rq_lock. */
+	struct spinlock rq_lock;
+	struct list ready_queues[PRI_CNT];
+	uint64_t ready_mask;
+	int ready_cnt;                      /* Number of ready threads. */
+
+	/* Deadline class run queue, also protected by rq_lock.  Ready
+	   deadline threads with budget left wait in dl_queue, earliest
+	   deadline first, ahead of every priority level; those out of
+	   budget wait in dl_throttled for their next period. */
+	struct pqueue dl_queue;
+	struct list dl_throttled;
+	int dl_bw;                          /* Reserved bandwidth, per mille. */
+
+	/* Pages of threads that died on this CPU, kept warm for reuse
+	   by thread_create().  Protected by thread_cache_lock. */
+	struct spinlock thread_cache_lock;
+	void *thread_cache[THREAD_CACHE_MAX];
+	int thread_cache_cnt;
+
+	/* Statistics. */
+	long long thread_creates;           /* # of threads created. */
+	long long thread_cache_hits;        /* # of those from thread_cache. */
+	uint64_t create_cycles;             /* TSC cycles in thread_create(). */
+	uint64_t create_cycles_max;         /* Slowest thread_create(). */
+};
+
+extern struct cpu cpus[CPU_MAX];
+extern unsigned cpu_cnt;
+
+/* Returns the CPU we are running on.
+
+   The kernel is still uniprocessor: the run queues and spin locks
+   here are groundwork for SMP, but nothing starts the application
+   processors yet.  That needs a real-mode trampoline, LAPIC and MADT discovery, per-CPU GDT, TSS and GS
+   setup, IPIs for remote wakeups and reschedules, and spin locks
+   in place of the intr_disable() critical sections in synch.c and
+   elsewhere.  Until then cpu_cnt is 1 and this is always CPU 0.
+   Once application processors run, this must instead read a
+   pointer that each CPU keeps at the base of its GS segment. */
+static inline struct cpu *
+this_cpu (void) {
+	return &cpus[0];
+}
+
+#endif /* threads/cpu.h */
@@ -0,0 +1,11 @@
+#ifndef THREADS_FUTEX_H
+#define THREADS_FUTEX_H
+
+#include <stdbool.h>
+
+void futex_init (void);
+bool futex_wait (const int *addr, int val, const bool *cancel);
+int futex_wake (const int *addr, int cnt);
+void futex_cancel (const bool *cancel);
+
+#endif /* threads/futex.h */
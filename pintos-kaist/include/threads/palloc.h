@@ -1,23 +1,52 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
+/* The page allocator hands out blocks of up to 2**(PALLOC_ORDERS
+   - 1) pages. */
+#define PALLOC_ORDERS 11
+#define PALLOC_MAX_PAGES ((size_t) 1 << (PALLOC_ORDERS - 1))
+
 /* How to allocate pages. */
 enum palloc_flags {
 	PAL_ASSERT = 001,           /* Panic on failure. */
 	PAL_ZERO = 002,             /* Zero page contents. */
-	PAL_USER = 004              /* User page. */
+	PAL_USER = 004,             /* User page. */
+	PAL_NOTRACK = 010           /* Not for the allocation tracker. */
 };
 
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
+/* Page allocator statistics for one pool. */
+struct palloc_stats {
+	size_t free_pages;                  /* Free pages, including zeroed. */
+	size_t free_blocks[PALLOC_ORDERS];  /* Free blocks of 2**N pages. */
+	size_t alloc_cnt;                   /* Successful allocations. */
+	uint64_t alloc_cycles;              /* TSC cycles spent allocating. */
+	size_t zero_pages;                  /* Free pages already zeroed. */
+	size_t zero_hits;                   /* PAL_ZERO pages found zeroed. */
+	size_t zero_misses;                 /* PAL_ZERO pages zeroed on demand. */
+	size_t zero_fills;                  /* Pages zeroed while idle. */
+};
+
+/* Frees pages that a cache is holding on to, returning the
+   number of pages freed.  Called when the kernel pool runs dry. */
+typedef size_t palloc_reclaim_func (void);
+
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_register_reclaim (palloc_reclaim_func *);
+void palloc_set_owner (void *pages, size_t page_cnt, void *owner);
+void *palloc_get_owner (const void *addr);
+void palloc_get_stats (enum palloc_flags, struct palloc_stats *);
+void palloc_print_stats (void);
+bool palloc_zero_refill (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,35 @@
+#ifndef THREADS_SCHEDTRACE_H
+#define THREADS_SCHEDTRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Scheduler event types, as printed in the trace dump. */
+enum sched_event_type {
+	SCHED_WAKEUP = 'W',         /* Thread made ready by thread_unblock(). */
+	SCHED_SWITCH_IN = 'I',      /* Thread got the CPU. */
+	SCHED_SWITCH_OUT = 'O',     /* Thread gave up the CPU. */
+};
+
+/* Why a thread gave up the CPU. */
+enum sched_out_reason {
+	SCHED_OUT_YIELD,            /* Yielded or preempted; still ready. */
+	SCHED_OUT_LOCK,             /* Blocked on a lock. */
+	SCHED_OUT_WAIT,             /* Blocked on another wait queue. */
+	SCHED_OUT_SLEEP,            /* Blocked otherwise, e.g. timer_sleep(). */
+	SCHED_OUT_EXIT,             /* Exited. */
+};
+
+/* Per-thread scheduling state kept while tracing. */
+struct sched_stats;
+
+extern bool sched_trace_enabled;
+
+void sched_trace_init (void);
+void sched_trace_wakeup (struct thread *);
+void sched_trace_switch (struct thread *prev, struct thread *next);
+void sched_trace_print (void);
+
+#endif /* threads/schedtrace.h */
@@ -0,0 +1,30 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* A cache of objects of one type.  See slab.c. */
+struct slab_cache;
+
+/* Puts the object at OBJ into its constructed state. */
+typedef void slab_ctor_func (void *obj);
+
+/* Statistics for one cache. */
+struct slab_stats {
+	size_t obj_size;            /* Bytes per object, after alignment. */
+	size_t objs_per_slab;       /* Objects in each page-sized slab. */
+	size_t slab_cnt;            /* Slabs in the cache. */
+	size_t in_use;              /* Objects allocated. */
+	long long allocs;           /* Calls to slab_alloc() that succeeded. */
+};
+
+void slab_init (void);
+struct slab_cache *slab_cache_create (const char *name, size_t size,
+		slab_ctor_func *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+size_t slab_reclaim (void);
+void slab_get_stats (struct slab_cache *, struct slab_stats *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
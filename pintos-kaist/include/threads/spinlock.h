@@ -0,0 +1,30 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+
+struct cpu;
+
+/* Spin lock.
+
+   Protects data that is touched with interrupts off, such as the
+   run queues, where a thread cannot block.  With a single CPU
+   disabling interrupts already gives mutual exclusion, so the
+   lock never actually spins; it is there so that the same code
+   stays correct once more CPUs are running.
+
+   A spin lock must only be acquired with interrupts off, and the
+   holder must not sleep or re-enable interrupts until it releases
+   the lock. */
+struct spinlock {
+	volatile int locked;        /* Nonzero while held. */
+	struct cpu *holder;         /* CPU holding the lock (for debugging). */
+	const char *name;           /* Name (for debugging). */
+};
+
+void spinlock_init (struct spinlock *, const char *name);
+void spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held_by_current_cpu (const struct spinlock *);
+
+#endif /* threads/spinlock.h */
@@ -2,12 +2,24 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <pqueue.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifdef LOCK_PROFILE
+/* Contention statistics shared by all the locks initialized
+   under one name.  See threads/synch.c. */
+struct lock_class;
+extern bool lock_profile;
+#endif
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct pqueue waiters;      /* Waiting threads, by priority. */
+#ifdef LOCK_PROFILE
+	struct lock_class *class;   /* Charged for waits, if profiled. */
+#endif
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -20,17 +32,63 @@ void sema_self_test (void);
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct pq_elem held_elem;   /* In holder's held_locks, keyed by the
+	                               highest priority donated through it. */
+#ifdef LOCK_PROFILE
+	uint64_t acquired_at;       /* TSC when last acquired. */
+#endif
 };
 
-void lock_init (struct lock *);
+/* Locks are named after the expression they were initialized
+   through, e.g. "&filesys_lock", for the lock profiler. */
+#define lock_init(LOCK) lock_init_named ((LOCK), #LOCK)
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Reader-writer lock.  Any number of readers, or a single
+   writer, may hold it at once.  Writers take precedence: once a
+   writer is waiting, new readers wait too. */
+struct rwlock {
+	struct list readers;        /* rw_hold of each reader. */
+	struct thread *writer;      /* Thread holding it for writing. */
+	struct pq_elem held_elem;   /* In writer's held_locks. */
+	struct pqueue read_waiters; /* Waiting readers, by priority. */
+	struct pqueue write_waiters; /* Waiting writers, by priority. */
+#ifdef LOCK_PROFILE
+	struct lock_class *class;   /* Profiling statistics. */
+	uint64_t acquired_at;       /* TSC when the writer acquired it. */
+#endif
+};
+
+/* One reader's hold on an rwlock.  The reader keeps it, usually
+   in its stack frame, from rwlock_acquire_read() until the
+   matching rwlock_release_read(). */
+struct rw_hold {
+	struct rwlock *rwlock;      /* Lock read. */
+	struct thread *thread;      /* Reading thread. */
+	struct list_elem elem;      /* Element in rwlock's readers. */
+	struct pq_elem held_elem;   /* In reader's held_locks, keyed by the
+	                               highest priority donated through it. */
+#ifdef LOCK_PROFILE
+	uint64_t acquired_at;       /* TSC when the reader acquired it. */
+#endif
+};
+
+#define rwlock_init(RWLOCK) rwlock_init_named ((RWLOCK), #RWLOCK)
+void rwlock_init_named (struct rwlock *, const char *name);
+void rwlock_acquire_read (struct rwlock *, struct rw_hold *);
+void rwlock_release_read (struct rwlock *, struct rw_hold *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+void rwlock_donate (struct rwlock *, int priority);
+
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct pqueue waiters;      /* Waiting threads, by priority. */
 };
 
 void cond_init (struct condition *);
@@ -38,6 +96,8 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+void lock_print_stats (void);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
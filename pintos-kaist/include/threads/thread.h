@@ -4,6 +4,8 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include <timer-wheel.h>
+#include "threads/fixed-point.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -12,6 +14,8 @@
 #include "vm/vm.h"
 #endif
 
+struct cpu;
+
 
 /* States in a thread's life cycle. */
 enum thread_status {
@@ -31,6 +35,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the MLFQS. */
+#define NICE_MIN -20                    /* Nicest. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
 #define FDT_PAGES 14  // pages allocate for file descriptor tables 
 #define FDCOUNT_LIMIT FDT_PAGES * (1<<9) // fd_idx limit
 
@@ -100,20 +109,62 @@ struct thread {
 
 	int original_priority;				/* Use to memorize priority before donation */
 
-	struct lock *wait_on_lock;
-	struct list donations;				/* donators */
-	struct list_elem d_elem; 			/* donation list element */
-
-
-	int64_t wakeup_ticks;   /* wakeup ticks */
+	struct lock *wait_on_lock;          /* Lock being waited for, if any. */
+	struct rwlock *wait_on_rwlock;      /* Rwlock being waited for, if any. */
+	struct pqueue held_locks;           /* Held locks, by donated priority. */
+	struct rw_hold *read_hold;          /* Hold to read a waited-for rwlock. */
+
+
+	struct timer_wheel_elem sleep_elem; /* Sleep wheel element; expires at the wakeup tick */
+	struct cpu *cpu;                    /* CPU whose run queue the thread uses. */
+
+	/* Scheduler tracing; see threads/schedtrace.c. */
+	struct sched_stats *sched_stats;    /* Histograms, if any. */
+	uint64_t ready_at;                  /* TSC when last made ready. */
+	uint64_t run_at;                    /* TSC when last switched in. */
+
+	/* MLFQS bookkeeping. */
+	int nice;                           /* Niceness. */
+	fixed_t recent_cpu;                 /* Recent CPU time received. */
+	int64_t decay_sec;                  /* Seconds of recent_cpu decay applied. */
+
+	/* Deadline scheduling class; see thread_set_deadline(). */
+	bool dl;                            /* In the deadline class? */
+	bool dl_throttled;                  /* Out of budget until dl_next? */
+	int64_t dl_runtime;                 /* Budget per period, in ticks. */
+	int64_t dl_rel_deadline;            /* Deadline after release, in ticks. */
+	int64_t dl_period;                  /* Period, in ticks. */
+	int64_t dl_deadline;                /* Absolute deadline of this job. */
+	int64_t dl_next;                    /* Earliest release of next job. */
+	int64_t dl_budget;                  /* Ticks of budget left. */
+	long long dl_throttles;             /* # of times the budget ran out. */
+	struct pq_elem dl_elem;             /* Deadline run queue element. */
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
+	struct pq_elem wait_elem;           /* Semaphore wait queue element. */
+	struct pqueue *wait_queue;          /* Queue holding wait_elem, if any. */
+	struct pq_elem *cond_elem;          /* Condition wait queue element, */
+	struct pqueue *cond_queue;          /* ...and its queue, if waiting. */
 
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
-	
+
+	/* Threads of one process; see process_thread_create().  The
+	   main thread, or leader, owns the address space and the file
+	   descriptor table that the others share, and keeps the
+	   fields below for the whole group. */
+	struct thread *leader;              /* Main thread of the process. */
+	int stack_slot;                     /* User stack slot, 0 for main. */
+	struct list_elem group_elem;        /* Element in leader's group. */
+	struct lock group_lock;             /* Leader: protects fields below. */
+	struct condition group_cond;        /* Leader: a thread has left. */
+	struct list group;                  /* Leader: unjoined other threads. */
+	int group_live;                     /* Leader: other threads running. */
+	unsigned stack_slots;               /* Leader: stack slots in use. */
+	bool killed;                        /* Leader: exit() was called. */
+	struct io_ring_ctx *io_ring;        /* Leader: async I/O ring, if any. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
@@ -133,9 +184,11 @@ struct thread {
 
 	short exit_status;
 	// struct semaphore fork_sema;
-	struct intr_frame pf;					// parent interrupt frame
 	/* Owned by thread.c. */
-	struct intr_frame tf;               /* Information for switching */
+	struct intr_frame tf;               /* Context for the first launch */
+	uint64_t switch_rsp;                /* Saved rsp while switched out. */
+	uint8_t *fpu;                       /* FXSAVE area, 16-byte aligned. */
+	void *fpu_alloc;                    /* Allocation holding fpu. */
 	unsigned magic;                     /* Detects stack overflow. */
 };
 
@@ -146,15 +199,16 @@ extern bool thread_mlfqs;
 
 /* -------- newly added functions ---------- */
 void donate_priority();
+void donate_priority_chain(struct thread *t, int priority);
 void remove_donators(struct lock *lock);
 void restore_priority();
+void thread_update_priority (struct thread *, int priority);
+void thread_preempt (void);
 
-static struct thread *next_thread_to_run (void);
 void wake_up(int64_t ticks);
 void thread_sleep(int64_t ticks);
-
-bool less_ticks(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
-bool more_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
+int64_t thread_next_wakeup (void);
+void thread_idle_ticks (int64_t cnt);
 /* ----------------------------------------- */
 void thread_init (void);
 void thread_start (void);
@@ -180,6 +234,8 @@ void thread_set_priority (int);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
+
+bool thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
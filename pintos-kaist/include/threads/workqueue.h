@@ -0,0 +1,37 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Deferred work priorities. */
+enum work_priority {
+	WORK_HIGH,                  /* Run on interrupt return; may not sleep. */
+	WORK_NORMAL,                /* Run by a worker thread; may sleep. */
+	WORK_PRI_CNT
+};
+
+typedef void work_func (void *aux);
+
+/* A unit of deferred work.  Embed it in the structure that the
+   work is about, and initialize it with work_init(). */
+struct work {
+	struct list_elem elem;      /* Queue element. */
+	work_func *func;            /* Function to call. */
+	void *aux;                  /* Argument for FUNC. */
+	bool pending;               /* Queued but not yet started? */
+	uint64_t queued_at;         /* TSC when queued. */
+};
+
+void workqueue_init (void);
+void workqueue_start (void);
+void workqueue_print_stats (void);
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct work *, enum work_priority);
+
+bool workqueue_softirq_pending (void);
+void workqueue_softirq (void);
+
+#endif /* threads/workqueue.h */
@@ -0,0 +1,11 @@
+#ifndef USERPROG_HUGEPAGE_H
+#define USERPROG_HUGEPAGE_H
+
+#include "threads/thread.h"
+
+void hugepage_init (void);
+void hugepage_register (struct thread *leader);
+void hugepage_unregister (struct thread *leader);
+void hugepage_print_stats (void);
+
+#endif /* userprog/hugepage.h */
@@ -0,0 +1,12 @@
+#ifndef USERPROG_IO_RING_H
+#define USERPROG_IO_RING_H
+
+#include <stdbool.h>
+#include "threads/thread.h"
+
+void *io_ring_setup (unsigned entries, unsigned flags);
+int io_ring_enter (unsigned to_submit, unsigned min_complete);
+void io_ring_destroy (struct thread *leader);
+bool io_ring_maps (struct thread *leader, const void *upage);
+
+#endif /* userprog/io-ring.h */
@@ -5,11 +5,18 @@
 
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
-int process_exec (void *f_name);
+int process_exec (const void *f_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (struct thread *next);
 
+tid_t process_thread_create (struct intr_frame *if_, void *entry,
+		void *arg0, void *arg1);
+int process_thread_join (tid_t);
+void process_thread_exit (int status);
+bool process_kill (int status);
+void process_check_killed (void);
+
 void push_args(char **argv, int argc, struct intr_frame *if_);
 
 #endif /* userprog/process.h */
@@ -1,7 +1,11 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+struct file;
+struct thread;
+
 void syscall_init (void);
-extern struct lock filesys_lock;
+int add_file_to (struct thread *leader, struct file *);
+extern struct rwlock filesys_lock;
 
 #endif /* userprog/syscall.h */
@@ -0,0 +1,198 @@
+#include "pqueue.h"
+#include "../debug.h"
+
+/* Pairing heap.  See Fredman, Sedgewick, Sleator and Tarjan,
+   "The Pairing Heap: A New Form of Self-Adjusting Heap",
+   Algorithmica 1 (1986).
+
+   Every element's key is at least as large as its children's
+   keys (ties broken by push order), so the root is the maximum.
+   Each element's children form a doubly linked sibling list; the
+   first child's PREV points back to the parent, which lets an
+   arbitrary element be cut out of the tree in O(1). */
+
+/* Returns true if A should come out of the queue before B. */
+static inline bool
+before (const struct pq_elem *a, const struct pq_elem *b) {
+	return a->key > b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+/* Links two trees, A and B, whose roots have no siblings, and
+   returns the root of the result.  Either may be null. */
+static struct pq_elem *
+meld (struct pq_elem *a, struct pq_elem *b) {
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (before (b, a)) {
+		struct pq_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	/* B becomes A's first child. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Combines the sibling list starting at FIRST into a single tree
+   and returns its root, using the standard two-pass scheme: meld
+   the siblings in pairs from left to right, then meld the pairs
+   from right to left. */
+static struct pq_elem *
+merge_pairs (struct pq_elem *first) {
+	struct pq_elem *pairs = NULL;
+	struct pq_elem *root = NULL;
+
+	/* First pass.  The melded pairs are stacked through NEXT. */
+	while (first != NULL) {
+		struct pq_elem *a = first;
+		struct pq_elem *b = a->next;
+		struct pq_elem *m;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL)
+			b->next = b->prev = NULL;
+		m = meld (a, b);
+		m->next = pairs;
+		pairs = m;
+	}
+
+	/* Second pass, starting from the last pair. */
+	while (pairs != NULL) {
+		struct pq_elem *m = pairs;
+
+		pairs = m->next;
+		m->next = NULL;
+		root = meld (root, m);
+	}
+	return root;
+}
+
+/* Cuts E, which is not the root, and its subtree out of the
+   tree. */
+static void
+cut (struct pq_elem *e) {
+	if (e->prev->child == e)
+		e->prev->child = e->next;
+	else
+		e->prev->next = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	e->next = e->prev = NULL;
+}
+
+/* Initializes PQ as an empty priority queue. */
+void
+pq_init (struct pqueue *pq) {
+	ASSERT (pq != NULL);
+
+	pq->root = NULL;
+	pq->size = 0;
+	pq->next_seq = 0;
+}
+
+/* Inserts E into PQ with the given KEY.  E comes out after any
+   element already in PQ with the same key. */
+void
+pq_push (struct pqueue *pq, struct pq_elem *e, int key) {
+	ASSERT (pq != NULL);
+	ASSERT (e != NULL);
+
+	e->child = e->next = e->prev = NULL;
+	e->key = key;
+	e->seq = pq->next_seq++;
+	pq->root = meld (pq->root, e);
+	pq->size++;
+}
+
+/* Returns the element of PQ that would be popped next, without
+   removing it, or a null pointer if PQ is empty. */
+struct pq_elem *
+pq_max (struct pqueue *pq) {
+	ASSERT (pq != NULL);
+
+	return pq->root;
+}
+
+/* Removes and returns the element with the largest key in PQ,
+   which must not be empty. */
+struct pq_elem *
+pq_pop (struct pqueue *pq) {
+	struct pq_elem *max;
+
+	ASSERT (pq != NULL);
+	ASSERT (!pq_empty (pq));
+
+	max = pq->root;
+	pq->root = merge_pairs (max->child);
+	pq->size--;
+	max->child = NULL;
+	return max;
+}
+
+/* Removes E, which must be in PQ, from PQ. */
+void
+pq_remove (struct pqueue *pq, struct pq_elem *e) {
+	ASSERT (pq != NULL);
+	ASSERT (e != NULL);
+	ASSERT (!pq_empty (pq));
+
+	if (e == pq->root) {
+		pq_pop (pq);
+		return;
+	}
+	cut (e);
+	pq->root = meld (pq->root, merge_pairs (e->child));
+	pq->size--;
+	e->child = NULL;
+}
+
+/* Changes the key of E, which must be in PQ, to KEY.  E keeps its
+   place among elements with an equal key. */
+void
+pq_rekey (struct pqueue *pq, struct pq_elem *e, int key) {
+	ASSERT (pq != NULL);
+	ASSERT (e != NULL);
+
+	if (key >= e->key) {
+		/* E still beats its children, so only its link to its
+		   parent can be wrong. */
+		e->key = key;
+		if (e != pq->root) {
+			cut (e);
+			pq->root = meld (pq->root, e);
+		}
+	} else {
+		uint64_t seq = e->seq;
+
+		pq_remove (pq, e);
+		e->child = e->next = e->prev = NULL;
+		e->key = key;
+		e->seq = seq;
+		pq->root = meld (pq->root, e);
+		pq->size++;
+	}
+}
+
+/* Returns true if PQ is empty, false otherwise. */
+bool
+pq_empty (const struct pqueue *pq) {
+	ASSERT (pq != NULL);
+
+	return pq->root == NULL;
+}
+
+/* Returns the number of elements in PQ. */
+size_t
+pq_size (const struct pqueue *pq) {
+	ASSERT (pq != NULL);
+
+	return pq->size;
+}
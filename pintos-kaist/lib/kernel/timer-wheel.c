@@ -0,0 +1,162 @@
+#include "timer-wheel.h"
+#include <debug.h>
+
+/* Returns the slot index of tick T at level LEVEL. */
+static inline int
+slot_index (int64_t t, int level) {
+	return (t >> (level * TW_SLOT_BITS)) & (TW_SLOTS - 1);
+}
+
+/* Puts E, which is not on any list, into the slot that matches
+   its expiry time relative to TW's clock. */
+static void
+place (struct timer_wheel *tw, struct timer_wheel_elem *e) {
+	int64_t delta = e->expires - tw->now;
+	int level;
+
+	/* Already expired: fire on the next tick that is processed. */
+	if (delta < 0) {
+		list_push_back (&tw->slots[0][slot_index (tw->now, 0)], &e->elem);
+		return;
+	}
+
+	for (level = 0; level < TW_LEVELS; level++)
+		if (delta < (int64_t) 1 << ((level + 1) * TW_SLOT_BITS)) {
+			list_push_back (&tw->slots[level][slot_index (e->expires, level)],
+					&e->elem);
+			return;
+		}
+	list_push_back (&tw->overflow, &e->elem);
+}
+
+/* Moves every element of LIST back into the wheel. */
+static void
+redistribute (struct timer_wheel *tw, struct list *list) {
+	while (!list_empty (list)) {
+		struct list_elem *le = list_pop_front (list);
+		place (tw, list_entry (le, struct timer_wheel_elem, elem));
+	}
+}
+
+/* Initializes TW as an empty wheel whose clock reads NOW. */
+void
+timer_wheel_init (struct timer_wheel *tw, int64_t now) {
+	int level, slot;
+
+	ASSERT (tw != NULL);
+
+	tw->now = now;
+	tw->cnt = 0;
+	for (level = 0; level < TW_LEVELS; level++)
+		for (slot = 0; slot < TW_SLOTS; slot++)
+			list_init (&tw->slots[level][slot]);
+	list_init (&tw->overflow);
+}
+
+/* Inserts E into TW so that it expires at tick EXPIRES.  An
+   EXPIRES in the past expires on the next advance. */
+void
+timer_wheel_insert (struct timer_wheel *tw, struct timer_wheel_elem *e,
+		int64_t expires) {
+	ASSERT (tw != NULL);
+	ASSERT (e != NULL);
+
+	e->expires = expires;
+	place (tw, e);
+	tw->cnt++;
+}
+
+/* Removes pending element E from TW before it expires. */
+void
+timer_wheel_remove (struct timer_wheel *tw, struct timer_wheel_elem *e) {
+	ASSERT (tw != NULL && tw->cnt > 0);
+
+	list_remove (&e->elem);
+	tw->cnt--;
+}
+
+/* Advances TW's clock through tick NOW, inclusive, and appends
+   every element that expired on the way to EXPIRED in expiry
+   order.  Costs O(1) per tick plus O(1) amortized per element. */
+void
+timer_wheel_advance (struct timer_wheel *tw, int64_t now,
+		struct list *expired) {
+	ASSERT (tw != NULL);
+	ASSERT (expired != NULL);
+
+	while (tw->now <= now) {
+		int idx = slot_index (tw->now, 0);
+
+		/* Nothing pending: jump the clock instead of stepping. */
+		if (tw->cnt == 0) {
+			tw->now = now + 1;
+			break;
+		}
+
+		/* At a level-0 wrap, cascade the matching slots of the
+		   higher levels down, stopping at the first level that
+		   did not wrap as well. */
+		if (idx == 0) {
+			int level;
+
+			for (level = 1; level < TW_LEVELS; level++) {
+				int hidx = slot_index (tw->now, level);
+				struct list cascade;
+
+				list_init (&cascade);
+				if (!list_empty (&tw->slots[level][hidx]))
+					list_splice (list_end (&cascade),
+							list_begin (&tw->slots[level][hidx]),
+							list_end (&tw->slots[level][hidx]));
+				redistribute (tw, &cascade);
+				if (hidx != 0)
+					break;
+			}
+			if (level == TW_LEVELS) {
+				struct list cascade;
+
+				list_init (&cascade);
+				if (!list_empty (&tw->overflow))
+					list_splice (list_end (&cascade), list_begin (&tw->overflow),
+							list_end (&tw->overflow));
+				redistribute (tw, &cascade);
+			}
+		}
+
+		while (!list_empty (&tw->slots[0][idx])) {
+			list_push_back (expired, list_pop_front (&tw->slots[0][idx]));
+			tw->cnt--;
+		}
+		tw->now++;
+	}
+}
+
+/* Returns a lower bound on the expiry of the earliest pending
+   element of TW, or INT64_MAX if TW is empty.  The bound is exact
+   when that element lies within the current level-0 window;
+   otherwise it is the next level-0 wrap, where the higher levels
+   cascade.  It is never later than the true earliest expiry. */
+int64_t
+timer_wheel_next_expiry (const struct timer_wheel *tw) {
+	int64_t t = tw->now;
+
+	if (tw->cnt == 0)
+		return INT64_MAX;
+
+	/* The higher levels have not cascaded into this window yet. */
+	if (slot_index (t, 0) == 0)
+		return t;
+
+	do {
+		if (!list_empty ((struct list *) &tw->slots[0][slot_index (t, 0)]))
+			return t;
+		t++;
+	} while (slot_index (t, 0) != 0);
+	return t;
+}
+
+/* Returns true if TW has no pending elements. */
+bool
+timer_wheel_empty (const struct timer_wheel *tw) {
+	return tw->cnt == 0;
+}
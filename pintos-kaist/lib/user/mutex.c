@@ -0,0 +1,122 @@
+#include <mutex.h>
+#include <debug.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* The mutex is the third one in Ulrich Drepper's "Futexes Are
+   Tricky".  Its state is 0 when free, 1 when held with no
+   waiters, and 2 when held with possible waiters.  Only the
+   transition out of 2 requires a futex_wake(). */
+
+/* Atomically sets *P to NEW if it equals OLD.  Returns the value
+   *P had before. */
+static inline int
+cmpxchg (int *p, int old, int new) {
+	asm volatile ("lock cmpxchgl %2, %1"
+			: "+a" (old), "+m" (*p)
+			: "r" (new)
+			: "memory");
+	return old;
+}
+
+/* Atomically sets *P to V and returns its previous value. */
+static inline int
+xchg (int *p, int v) {
+	asm volatile ("xchgl %0, %1" : "+r" (v), "+m" (*p) : : "memory");
+	return v;
+}
+
+/* Atomically adds V to *P. */
+static inline void
+atomic_add (int *p, int v) {
+	asm volatile ("lock addl %1, %0" : "+m" (*p) : "ir" (v) : "memory");
+}
+
+/* Reads *P once, without letting the compiler cache it. */
+static inline int
+load (const int *p) {
+	return *(const volatile int *) p;
+}
+
+/* Initializes M as a free mutex. */
+void
+mutex_init (struct mutex *m) {
+	m->state = 0;
+}
+
+/* Takes M for the sleepy path: marks it contended and sleeps
+   until it is free. */
+static void
+lock_contended (struct mutex *m) {
+	while (xchg (&m->state, 2) != 0)
+		futex_wait (&m->state, 2);
+}
+
+/* Acquires M, sleeping until it is available if necessary. */
+void
+mutex_lock (struct mutex *m) {
+	int c = cmpxchg (&m->state, 0, 1);
+
+	if (c != 0) {
+		if (c != 2 && xchg (&m->state, 2) == 0)
+			return;
+		lock_contended (m);
+	}
+}
+
+/* Acquires M if it is free and returns true, or returns false
+   without waiting. */
+bool
+mutex_trylock (struct mutex *m) {
+	return cmpxchg (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, which the caller must hold. */
+void
+mutex_unlock (struct mutex *m) {
+	if (xchg (&m->state, 0) == 2)
+		futex_wake (&m->state, 1);
+}
+
+/* Initializes CV. */
+void
+condvar_init (struct condvar *cv) {
+	cv->seq = 0;
+	cv->waiters = 0;
+}
+
+/* Atomically releases M and waits for CV to be signaled, then
+   reacquires M.  M must be held.  As in the kernel, wakeups may
+   be spurious, so the caller must recheck its condition. */
+void
+condvar_wait (struct condvar *cv, struct mutex *m) {
+	int seq = load (&cv->seq);
+
+	cv->waiters++;
+	mutex_unlock (m);
+	futex_wait (&cv->seq, seq);
+
+	/* Other threads may have been woken along with us, so take
+	   the mutex as contended to make sure they get woken in turn
+	   when we drop it. */
+	lock_contended (m);
+	cv->waiters--;
+}
+
+/* Wakes one thread waiting on CV, if any.  M must be held. */
+void
+condvar_signal (struct condvar *cv, struct mutex *m UNUSED) {
+	if (cv->waiters > 0) {
+		atomic_add (&cv->seq, 1);
+		futex_wake (&cv->seq, 1);
+	}
+}
+
+/* Wakes every thread waiting on CV.  M must be held. */
+void
+condvar_broadcast (struct condvar *cv, struct mutex *m UNUSED) {
+	if (cv->waiters > 0) {
+		atomic_add (&cv->seq, 1);
+		futex_wake (&cv->seq, INT_MAX);
+	}
+}
@@ -0,0 +1,73 @@
+#include <ring.h>
+#include <syscall.h>
+
+/* The process side of the rings.  The kernel consumes SQEs and
+   produces CQEs concurrently with us when a poller is running,
+   so every access to the other side's counter goes through
+   load(), and we publish our own counters with store() only
+   after the entries they cover are written. */
+
+/* Reads *P once, without letting the compiler cache it. */
+static inline uint32_t
+load (const uint32_t *p) {
+	return *(const volatile uint32_t *) p;
+}
+
+/* Publishes V in *P after every store before it. */
+static inline void
+store (uint32_t *p, uint32_t v) {
+	asm volatile ("" : : : "memory");
+	*(volatile uint32_t *) p = v;
+}
+
+/* Returns the next free SQE of RING, or a null pointer if the SQ
+   is full.  The SQE is not seen by the kernel until the next
+   io_ring_submit(). */
+struct io_sqe *
+io_ring_get_sqe (struct io_ring *ring) {
+	uint32_t tail = ring->sq_tail + ring->sq_fill;
+
+	if (tail - load (&ring->sq_head) >= ring->sq_entries)
+		return NULL;
+	ring->sq_fill++;
+	return &io_ring_sqes (ring)[tail & (ring->sq_entries - 1)];
+}
+
+/* Publishes the SQEs filled since the last call and, if WAIT_NR
+   is nonzero, waits until at least WAIT_NR CQEs are ready.
+   Returns the number of SQEs the kernel took, or -1 on error. */
+int
+io_ring_submit (struct io_ring *ring, unsigned wait_nr) {
+	unsigned cnt = ring->sq_fill;
+
+	store (&ring->sq_tail, ring->sq_tail + cnt);
+	ring->sq_fill = 0;
+
+	if (ring->setup_flags & IO_RING_SQPOLL) {
+		/* Pairs with the poller's check after it sets the flag. */
+		asm volatile ("mfence" : : : "memory");
+		if (wait_nr == 0 && !(load (&ring->flags) & IO_RING_NEED_WAKEUP))
+			return cnt;
+	}
+	return io_ring_enter (cnt, wait_nr);
+}
+
+/* Returns RING's oldest unreaped CQE, or a null pointer if there
+   is none. */
+struct io_cqe *
+io_ring_peek_cqe (struct io_ring *ring) {
+	uint32_t head = ring->cq_head;
+
+	if (head == load (&ring->cq_tail))
+		return NULL;
+	asm volatile ("" : : : "memory");
+	return &io_ring_cqes (ring, ring->sq_entries)[head
+		& (ring->cq_entries - 1)];
+}
+
+/* Marks the CQE returned by io_ring_peek_cqe() as reaped, freeing
+   its slot for the kernel. */
+void
+io_ring_cqe_seen (struct io_ring *ring) {
+	store (&ring->cq_head, ring->cq_head + 1);
+}
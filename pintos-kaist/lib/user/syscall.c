@@ -145,6 +145,54 @@ dup2 (int oldfd, int newfd){
 	return syscall2 (SYS_DUP2, oldfd, newfd);
 }
 
+int
+futex_wait (int *addr, int val) {
+	return syscall2 (SYS_FUTEX_WAIT, addr, val);
+}
+
+int
+futex_wake (int *addr, int cnt) {
+	return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+bool
+sched_deadline (int runtime, int deadline, int period) {
+	return syscall3 (SYS_SCHED_DEADLINE, runtime, deadline, period);
+}
+
+/* Where a new thread starts: runs FUNC and exits with its
+   return value. */
+static void
+thread_start (thread_func *func, void *aux) {
+	thread_exit (func (aux));
+}
+
+tid_t
+thread_create (thread_func *func, void *aux) {
+	return (tid_t) syscall3 (SYS_THREAD_CREATE, thread_start, func, aux);
+}
+
+int
+thread_join (tid_t tid) {
+	return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (int status) {
+	syscall1 (SYS_THREAD_EXIT, status);
+	NOT_REACHED ();
+}
+
+struct io_ring *
+io_ring_setup (unsigned entries, unsigned flags) {
+	return (struct io_ring *) syscall2 (SYS_IO_RING_SETUP, entries, flags);
+}
+
+int
+io_ring_enter (unsigned to_submit, unsigned min_complete) {
+	return syscall2 (SYS_IO_RING_ENTER, to_submit, min_complete);
+}
+
 void *
 mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
 	return (void *) syscall5 (SYS_MMAP, addr, length, writable, fd, offset);
@@ -0,0 +1,51 @@
+/* Measures read throughput as the number of concurrent reader
+   processes grows.  Runs rounds of 1, 2, 4 and 8 copies of
+   child-syn-read, each of which reads the same file a byte at a
+   time and checks its contents, and reports how many bytes all
+   of the readers of each round got through per million TSC
+   cycles.  Opening the file and looking up its directory entry
+   and inode only take the file system locks for reading.  read()
+   takes the file system lock exclusively because it moves the
+   file position, so this shows how much of the rest overlaps. */
+
+#include <random.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/syn-read.h"
+
+static char buf[BUF_SIZE];
+
+#define MAX_READERS 8
+
+void
+test_main (void) 
+{
+  pid_t children[MAX_READERS];
+  size_t readers;
+  int fd;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) > 0, "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  for (readers = 1; readers <= MAX_READERS; readers *= 2) 
+    {
+      uint64_t start, cycles;
+
+      quiet = true;
+      start = rdtsc ();
+      exec_children ("child-syn-read", children, readers);
+      wait_children (children, readers);
+      cycles = rdtsc () - start;
+      quiet = false;
+
+      msg ("%zu readers: %llu bytes per million cycles", readers,
+           (unsigned long long) (readers * sizeof buf * 1000000ULL
+                                 / (cycles > 0 ? cycles : 1)));
+    }
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers:
+#
+# (syn-read-scale) 1 readers: 36 bytes per million cycles
+# (syn-read-scale) 2 readers: 41 bytes per million cycles
+# (syn-read-scale) 4 readers: 44 bytes per million cycles
+# (syn-read-scale) 8 readers: 45 bytes per million cycles
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "child process failed\n"
+  if grep (/^child-syn-read: exit\(-1\)/, @output);
+foreach my $readers (1, 2, 4, 8) {
+    fail "missing throughput for $readers readers\n"
+      if !grep (/\(syn-read-scale\) $readers readers: \d+ bytes per million cycles/,
+		@output);
+}
+
+pass;
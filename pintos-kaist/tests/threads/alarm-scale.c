@@ -0,0 +1,127 @@
+/* Measures how the alarm clock scales with the number of
+   sleeping threads.  For each sleeper count, starts that many
+   threads that each sleep a varying number of ticks ITERATIONS
+   times, and records how many ticks late each wakeup was
+   (jitter).  Also reports the average number of TSC cycles spent
+   in the timer interrupt handler per tick during each run, which
+   should stay flat as the sleeper count grows. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ITERATIONS 10
+
+/* Information about one run of the test. */
+struct scale_test 
+  {
+    struct semaphore done;      /* Upped by each sleeper when done. */
+    struct lock lock;           /* Protects the fields below. */
+    int wakeups;                /* Number of wakeups recorded. */
+    int64_t total_jitter;       /* Sum of ticks late over all wakeups. */
+    int64_t max_jitter;         /* Largest number of ticks late. */
+  };
+
+/* Information about an individual sleeper. */
+struct scale_sleeper 
+  {
+    struct scale_test *test;    /* Info shared between all sleepers. */
+    int id;                     /* Sleeper ID. */
+  };
+
+static void run_sleepers (int sleeper_cnt);
+static thread_func sleeper;
+
+void
+test_alarm_scale (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Each sleeper sleeps 1 to 16 ticks, %d times.", ITERATIONS);
+  run_sleepers (8);
+  run_sleepers (32);
+  run_sleepers (96);
+}
+
+/* Runs SLEEPER_CNT sleepers to completion and reports the
+   observed jitter and timer interrupt cost. */
+static void
+run_sleepers (int sleeper_cnt) 
+{
+  struct scale_test test;
+  struct scale_sleeper *sleepers;
+  uint64_t start_cycles, end_cycles;
+  int64_t start_isrs, end_isrs;
+  int64_t isrs;
+  int i;
+
+  sleepers = malloc (sizeof *sleepers * sleeper_cnt);
+  if (sleepers == NULL)
+    PANIC ("couldn't allocate memory for test");
+
+  sema_init (&test.done, 0);
+  lock_init (&test.lock);
+  test.wakeups = 0;
+  test.total_jitter = 0;
+  test.max_jitter = 0;
+
+  start_isrs = timer_isr_stats (&start_cycles);
+  for (i = 0; i < sleeper_cnt; i++) 
+    {
+      char name[24];
+
+      sleepers[i].test = &test;
+      sleepers[i].id = i;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, &sleepers[i]) == TID_ERROR)
+        fail ("couldn't create sleeper %d", i);
+    }
+  for (i = 0; i < sleeper_cnt; i++)
+    sema_down (&test.done);
+  end_isrs = timer_isr_stats (&end_cycles);
+
+  if (test.wakeups != sleeper_cnt * ITERATIONS)
+    fail ("%d wakeups instead of %d", test.wakeups, sleeper_cnt * ITERATIONS);
+
+  isrs = end_isrs - start_isrs;
+  msg ("%d sleepers: max jitter %lld ticks, mean jitter %lld/100 ticks, "
+       "%llu cycles per timer interrupt",
+       sleeper_cnt, test.max_jitter, test.total_jitter * 100 / test.wakeups,
+       isrs > 0 ? (end_cycles - start_cycles) / isrs : 0);
+
+  free (sleepers);
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *s_) 
+{
+  struct scale_sleeper *s = s_;
+  struct scale_test *test = s->test;
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      int64_t duration = 1 + (s->id * 7 + i * 3) % 16;
+      int64_t wake = timer_ticks () + duration;
+      int64_t jitter;
+
+      timer_sleep (duration);
+      jitter = timer_ticks () - wake;
+      if (jitter < 0)
+        fail ("sleeper %d woke up %lld ticks early", s->id, -jitter);
+
+      lock_acquire (&test->lock);
+      test->wakeups++;
+      test->total_jitter += jitter;
+      if (jitter > test->max_jitter)
+        test->max_jitter = jitter;
+      lock_release (&test->lock);
+    }
+  sema_up (&test->done);
+}
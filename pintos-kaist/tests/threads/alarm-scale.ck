@@ -0,0 +1,24 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers:
+#
+# (alarm-scale) Each sleeper sleeps 1 to 16 ticks, 10 times.
+# (alarm-scale) 8 sleepers: max jitter 0 ticks, mean jitter 0/100 ticks, 2795 cycles per timer interrupt
+# (alarm-scale) 32 sleepers: max jitter 1 ticks, mean jitter 2/100 ticks, 3120 cycles per timer interrupt
+# (alarm-scale) 96 sleepers: max jitter 1 ticks, mean jitter 5/100 ticks, 3388 cycles per timer interrupt
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@runs) = grep (/\d+ sleepers: max jitter \d+ ticks/, @output);
+fail "Expected 3 sleeper runs but found " . scalar (@runs) . "\n"
+  if @runs != 3;
+
+pass;
@@ -23,6 +23,15 @@ test_alarm_multiple (void)
 {
   test_sleep (5, 7);
 }
+
+/* Same as alarm-multiple, but run with -tickless, so that the
+   timer is mostly in one-shot mode while the sleepers wait. */
+void
+test_alarm_tickless (void) 
+{
+  ASSERT (timer_tickless);
+  test_sleep (5, 7);
+}
 
 /* Information about the test. */
 struct sleep_test 
@@ -0,0 +1,153 @@
+/* Runs periodic threads in the deadline scheduling class while
+   CPU hogs at the highest priority try to take over the CPU, and
+   counts the jobs that finish after their deadline.  The deadline
+   class runs ahead of every priority, so no deadline should be
+   missed.  Also checks that admission control refuses a
+   reservation that would take the CPU over DL_BW_MAX. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define HOG_CNT 3                       /* Number of CPU hogs. */
+#define RUN_TICKS 200                   /* Length of the run. */
+
+/* A periodic thread in the deadline class. */
+struct periodic 
+  {
+    int work;                   /* Ticks of work per job. */
+    int runtime;                /* Reserved ticks per period. */
+    int deadline;               /* Relative deadline, in ticks. */
+    int period;                 /* Period, in ticks. */
+    int jobs;                   /* Jobs run. */
+    int misses;                 /* Jobs finished after their deadline. */
+  };
+
+static struct periodic periodics[] = 
+  {
+    {1, 2, 5, 5, 0, 0},
+    {1, 2, 8, 10, 0, 0},
+    {2, 3, 20, 20, 0, 0},
+  };
+#define PERIODIC_CNT (sizeof periodics / sizeof *periodics)
+
+static int64_t loops_per_tick;          /* Calibrated spin loops. */
+static int64_t start, end;              /* Ticks bounding the run. */
+static struct semaphore ready, done;
+static thread_func periodic_thread, hog_thread;
+
+static int64_t calibrate (void);
+static void spin (int64_t loops);
+
+void
+test_deadline_hogs (void) 
+{
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&ready, 0);
+  sema_init (&done, 0);
+  loops_per_tick = calibrate ();
+
+  /* Keep the CPU while starting the hogs. */
+  thread_set_priority (PRI_MAX);
+
+  start = timer_ticks () + 20;
+  end = start + RUN_TICKS;
+  for (i = 0; i < PERIODIC_CNT; i++) 
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "periodic %zu", i);
+      if (thread_create (name, PRI_DEFAULT, periodic_thread,
+                         &periodics[i]) == TID_ERROR)
+        fail ("couldn't create %s", name);
+    }
+  for (i = 0; i < PERIODIC_CNT; i++)
+    sema_down (&ready);
+
+  /* 75% is reserved now. */
+  if (thread_set_deadline (5, 20, 20))
+    fail ("admitted a reservation of another 25%");
+  msg ("Reservation over 95%% refused.");
+
+  for (i = 0; i < HOG_CNT; i++)
+    if (thread_create ("hog", PRI_MAX, hog_thread, NULL) == TID_ERROR)
+      fail ("couldn't create hog");
+  msg ("%d CPU hogs started at priority %d.", HOG_CNT, PRI_MAX);
+
+  for (i = 0; i < PERIODIC_CNT + HOG_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < PERIODIC_CNT; i++)
+    msg ("Thread with period %d: %d jobs, %d deadline misses.",
+         periodics[i].period, periodics[i].jobs, periodics[i].misses);
+}
+
+/* Joins the deadline class, then runs a job of P->work ticks in
+   every period from START to END. */
+static void
+periodic_thread (void *p_) 
+{
+  struct periodic *p = p_;
+  int64_t release;
+
+  if (!thread_set_deadline (p->runtime, p->deadline, p->period))
+    fail ("reservation of %d ticks every %d refused", p->runtime, p->period);
+  sema_up (&ready);
+
+  for (release = start; release + p->period <= end; release += p->period) 
+    {
+      int64_t now = timer_ticks ();
+
+      if (release > now)
+        timer_sleep (release - now);
+      spin (p->work * loops_per_tick);
+      if (timer_ticks () > release + p->deadline)
+        p->misses++;
+      p->jobs++;
+    }
+
+  thread_set_deadline (0, 0, 0);
+  sema_up (&done);
+}
+
+/* Spins until END. */
+static void
+hog_thread (void *aux UNUSED) 
+{
+  while (timer_ticks () < end)
+    continue;
+  sema_up (&done);
+}
+
+/* Returns the number of spin() loops that take one tick. */
+static int64_t
+calibrate (void) 
+{
+  int64_t loops = 0;
+  int64_t tick = timer_ticks ();
+
+  while (timer_ticks () == tick)
+    continue;
+  tick = timer_ticks ();
+  while (timer_ticks () == tick)
+    loops++;
+  return loops;
+}
+
+/* Burns the CPU for LOOPS iterations of calibrate()'s loop. */
+static void
+spin (int64_t loops) 
+{
+  volatile int64_t tick;
+
+  while (loops-- > 0)
+    tick = timer_ticks ();
+  (void) tick;
+}
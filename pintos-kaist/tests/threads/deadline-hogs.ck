@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(deadline-hogs) begin
+(deadline-hogs) Reservation over 95% refused.
+(deadline-hogs) 3 CPU hogs started at priority 63.
+(deadline-hogs) Thread with period 5: 40 jobs, 0 deadline misses.
+(deadline-hogs) Thread with period 10: 20 jobs, 0 deadline misses.
+(deadline-hogs) Thread with period 20: 10 jobs, 0 deadline misses.
+(deadline-hogs) end
+EOF
+pass;
@@ -0,0 +1,65 @@
+/* Contended futex handoff benchmark.  The main thread and a
+   partner thread of the same priority pass a turn word back and
+   forth HANDOFFS times, each sleeping in futex_wait() until the
+   other flips the word and calls futex_wake().  Every handoff
+   therefore goes through the slow, in-kernel path, and the test
+   reports the average number of TSC cycles per handoff. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/futex.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+#define HANDOFFS 20000
+
+static thread_func partner;
+static int turn;
+static struct semaphore done;
+
+/* Waits until TURN is ME, then hands the turn to the other
+   thread. */
+static void
+take_turn (int me) 
+{
+  while (turn != me)
+    futex_wait (&turn, !me, NULL);
+  turn = !me;
+  futex_wake (&turn, 1);
+}
+
+void
+test_futex_handoff (void) 
+{
+  uint64_t start, cycles;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  turn = 0;
+  sema_init (&done, 0);
+  thread_create ("partner", PRI_DEFAULT, partner, NULL);
+
+  start = rdtsc ();
+  for (i = 0; i < HANDOFFS / 2; i++)
+    take_turn (0);
+  sema_down (&done);
+  cycles = rdtsc () - start;
+
+  msg ("%d handoffs, %llu cycles per handoff", HANDOFFS, cycles / HANDOFFS);
+  msg ("futex_wake() with no sleepers woke %d threads",
+       futex_wake (&turn, 1));
+}
+
+static void
+partner (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < HANDOFFS / 2; i++)
+    take_turn (1);
+  sema_up (&done);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers:
+#
+# (futex-handoff) 20000 handoffs, 3120 cycles per handoff
+# (futex-handoff) futex_wake() with no sleepers woke 0 threads
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "missing handoff latency\n"
+  if !grep (/20000 handoffs, \d+ cycles per handoff/, @output);
+fail "futex_wake() woke a thread that was not sleeping\n"
+  if !grep (/no sleepers woke 0 threads/, @output);
+
+pass;
@@ -0,0 +1,81 @@
+/* Measures how fast small blocks can be allocated and freed.
+   For one second, THREAD_CNT threads each repeatedly allocate
+   BATCH blocks of random sizes up to 2 kB, fill each with a
+   pattern, then check and free them in the opposite order.
+   Reports the number of malloc()/free() pairs per second. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4                    /* Allocating threads. */
+#define BATCH 32                        /* Blocks held at once. */
+
+static struct semaphore done;           /* Upped by each thread. */
+static int64_t start;                   /* When to start counting. */
+static long long pairs[THREAD_CNT];     /* Pairs done by each thread. */
+static thread_func churn;
+
+void
+test_malloc_churn (void) 
+{
+  long long total = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  random_init (0);
+  sema_init (&done, 0);
+  start = timer_ticks ();
+  for (i = 0; i < THREAD_CNT; i++)
+    if (thread_create ("churn", PRI_DEFAULT, churn, &pairs[i]) == TID_ERROR)
+      fail ("couldn't create thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      sema_down (&done);
+      total += pairs[i];
+    }
+  msg ("%d threads, %d blocks held by each.", THREAD_CNT, BATCH);
+  msg ("%lld malloc/free pairs per second", total);
+}
+
+/* Allocates and frees batches of blocks for one second, counting
+   each block in *PAIRS_. */
+static void
+churn (void *pairs_) 
+{
+  long long *pairs = pairs_;
+  void *blocks[BATCH];
+  size_t sizes[BATCH];
+  int i;
+
+  while (timer_elapsed (start) < TIMER_FREQ)
+    {
+      for (i = 0; i < BATCH; i++)
+        {
+          sizes[i] = 1 + random_ulong () % 2048;
+          blocks[i] = malloc (sizes[i]);
+          if (blocks[i] == NULL)
+            fail ("out of memory");
+          memset (blocks[i], i, sizes[i]);
+        }
+      for (i = BATCH - 1; i >= 0; i--)
+        {
+          const unsigned char *p = blocks[i];
+
+          if (p[0] != i || p[sizes[i] - 1] != i)
+            fail ("block %d of %zu bytes was overwritten", i, sizes[i]);
+          free (blocks[i]);
+        }
+      *pairs += BATCH;
+      thread_yield ();
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+
+# The expected output looks like this, with a machine-dependent
+# number on the last line:
+#
+# (malloc-churn) 4 threads, 32 blocks held by each.
+# (malloc-churn) 2413568 malloc/free pairs per second
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "Missing allocation rate\n"
+  if !grep (/\d+ malloc\/free pairs per second/, @output);
+
+pass;
@@ -0,0 +1,61 @@
+/* Measures malloc() of large blocks.  For each of several sizes
+   from 3 kB to 24 kB, allocates BLOCK_CNT blocks and reports how
+   much of the memory taken from the page allocator the requests
+   leave unused, then reports the cycles per malloc()/free() pair
+   when one block of that size is allocated and freed over and
+   over.  Also checks that the blocks do not overlap. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define BLOCK_CNT 32                    /* Blocks of each size. */
+#define PAIR_CNT 1000                   /* Timed malloc()/free() pairs. */
+
+static const size_t sizes[] = {3000, 4096, 6000, 12000, 16384, 24000};
+
+void
+test_malloc_large (void) 
+{
+  static unsigned char *blocks[BLOCK_CNT];
+  size_t s;
+
+  for (s = 0; s < sizeof sizes / sizeof *sizes; s++)
+    {
+      struct palloc_stats before, after;
+      size_t used, i, j;
+      uint64_t start;
+
+      palloc_get_stats (0, &before);
+      for (i = 0; i < BLOCK_CNT; i++)
+        {
+          blocks[i] = malloc (sizes[s]);
+          if (blocks[i] == NULL)
+            fail ("out of memory");
+          memset (blocks[i], i, sizes[s]);
+        }
+      palloc_get_stats (0, &after);
+      for (i = 0; i < BLOCK_CNT; i++)
+        for (j = 0; j < sizes[s]; j += 512)
+          if (blocks[i][j] != i)
+            fail ("%zu-byte block %zu overlaps another", sizes[s], i);
+      used = (before.free_pages - after.free_pages) * PGSIZE;
+      msg ("%zu bytes: %zu%% of pages unused", sizes[s],
+           used > BLOCK_CNT * sizes[s]
+           ? (used - BLOCK_CNT * sizes[s]) * 100 / used : 0);
+      for (i = 0; i < BLOCK_CNT; i++)
+        free (blocks[i]);
+
+      start = rdtsc ();
+      for (i = 0; i < PAIR_CNT; i++)
+        free (malloc (sizes[s]));
+      msg ("%zu bytes: %llu cycles per malloc/free", sizes[s],
+           (rdtsc () - start) / PAIR_CNT);
+    }
+  msg ("done");
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers:
+#
+# (malloc-large) 3000 bytes: 2% of pages unused
+# (malloc-large) 3000 bytes: 310 cycles per malloc/free
+# ...
+# (malloc-large) done
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+foreach my $size (3000, 4096, 6000, 12000, 16384, 24000) {
+    fail "Missing fragmentation for $size bytes\n"
+      if !grep (/\b$size bytes: \d+% of pages unused/, @output);
+    fail "Missing latency for $size bytes\n"
+      if !grep (/\b$size bytes: \d+ cycles per malloc\/free/, @output);
+}
+fail "Test did not finish\n" if !grep (/\(malloc-large\) done/, @output);
+
+pass;
@@ -0,0 +1,67 @@
+/* Measures how the cost of the timer interrupt under the MLFQS
+   scales with the number of sleeping threads.  The main thread
+   spins for SPIN_SECONDS seconds three times: with no other
+   threads, with 20 sleepers, and with 60 sleepers that sleep
+   through the whole measurement.  It reports the average number
+   of TSC cycles spent in the timer interrupt handler per tick in
+   each case, which should not grow with the sleeper count, since
+   the once-a-second recent_cpu decay only touches threads that
+   can run.  Compare with the cycles reported by alarm-scale,
+   which runs without -mlfqs. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPIN_SECONDS 3
+#define SLEEP_SECONDS 30
+
+static void measure (int sleeper_cnt);
+static thread_func sleeper;
+
+void
+test_mlfqs_scale (void) 
+{
+  ASSERT (thread_mlfqs);
+
+  measure (0);
+  measure (20);
+  measure (40);
+}
+
+/* Adds SLEEPER_CNT sleepers to those already started, then spins
+   and reports the timer interrupt cost. */
+static void
+measure (int sleeper_cnt) 
+{
+  static int total_sleepers;
+  uint64_t start_cycles, end_cycles;
+  int64_t start_isrs, end_isrs;
+  int64_t start_time;
+  int i;
+
+  for (i = 0; i < sleeper_cnt; i++) 
+    {
+      char name[24];
+      snprintf (name, sizeof name, "sleeper %d", total_sleepers++);
+      thread_create (name, PRI_DEFAULT, sleeper, NULL);
+    }
+
+  start_isrs = timer_isr_stats (&start_cycles);
+  start_time = timer_ticks ();
+  while (timer_elapsed (start_time) < SPIN_SECONDS * TIMER_FREQ)
+    continue;
+  end_isrs = timer_isr_stats (&end_cycles);
+
+  msg ("%d sleepers: %llu cycles per timer interrupt", total_sleepers,
+       end_isrs > start_isrs
+       ? (end_cycles - start_cycles) / (end_isrs - start_isrs) : 0);
+}
+
+static void
+sleeper (void *aux UNUSED) 
+{
+  timer_sleep (SLEEP_SECONDS * TIMER_FREQ);
+}
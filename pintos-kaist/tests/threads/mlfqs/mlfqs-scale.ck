@@ -0,0 +1,23 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers that should stay roughly flat:
+#
+# (mlfqs-scale) 0 sleepers: 3411 cycles per timer interrupt
+# (mlfqs-scale) 20 sleepers: 3388 cycles per timer interrupt
+# (mlfqs-scale) 60 sleepers: 3402 cycles per timer interrupt
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@runs) = grep (/\d+ sleepers: \d+ cycles per timer interrupt/, @output);
+fail "Expected 3 measurements but found " . scalar (@runs) . "\n"
+  if @runs != 3;
+
+pass;
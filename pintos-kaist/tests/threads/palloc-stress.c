@@ -0,0 +1,137 @@
+/* Stresses the page allocator with the mix of requests that
+   running processes produce.  WORKERS threads each keep SLOTS
+   malloc() blocks of random size alive, replacing one at random
+   on every iteration, and now and then start a short-lived
+   "process" thread.  Like fork() and exec(), creating it takes a
+   thread page and a FDT_PAGES-page descriptor table, and the
+   thread itself then makes a large malloc() and frees it again.
+
+   Once every worker has filled its slots, reports how fragmented
+   free memory is: the largest free block, and how much of it
+   could serve a request as big as a descriptor table.  At the
+   end, reports the mean cost of an allocation. */
+
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+#define WORKERS 4                       /* Worker threads. */
+#define SLOTS 8                         /* Live blocks per worker. */
+#define ITERS 128                       /* Iterations per worker. */
+#define SPAWN_EVERY 8                   /* Iterations per process. */
+
+static struct semaphore loaded;         /* Upped when slots are full. */
+static struct semaphore go;             /* Lets workers free slots. */
+static struct semaphore done;           /* Upped by each thread. */
+static thread_func worker, process;
+
+/* Returns a random block size: small ones that come from arenas,
+   and large ones of up to 16 pages that come straight from the
+   page allocator. */
+static size_t
+random_size (void)
+{
+  if (random_ulong () % 2)
+    return 16 + random_ulong () % 1024;
+  return PGSIZE + random_ulong () % (16 * PGSIZE);
+}
+
+void
+test_palloc_stress (void)
+{
+  struct palloc_stats before, s;
+  size_t big_free, largest;
+  int order, i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  random_init (0);
+  sema_init (&loaded, 0);
+  sema_init (&go, 0);
+  sema_init (&done, 0);
+  palloc_get_stats (0, &before);
+
+  msg ("%d workers, %d iterations each.", WORKERS, ITERS);
+  for (i = 0; i < WORKERS; i++)
+    if (thread_create ("worker", PRI_DEFAULT, worker, NULL) == TID_ERROR)
+      fail ("couldn't create worker %d", i);
+  for (i = 0; i < WORKERS; i++)
+    sema_down (&loaded);
+
+  palloc_get_stats (0, &s);
+  big_free = largest = 0;
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    if (s.free_blocks[order] > 0)
+      {
+        largest = (size_t) 1 << order;
+        if (largest >= FDT_PAGES)
+          big_free += s.free_blocks[order] << order;
+      }
+  msg ("loaded: %zu free pages, largest free block %zu pages, "
+       "%zu%% in blocks of %d pages or more",
+       s.free_pages, largest, s.free_pages ? big_free * 100 / s.free_pages : 0,
+       FDT_PAGES);
+
+  for (i = 0; i < WORKERS; i++)
+    sema_up (&go);
+  for (i = 0; i < WORKERS * (1 + ITERS / SPAWN_EVERY); i++)
+    sema_down (&done);
+  msg ("All threads finished.");
+
+  palloc_get_stats (0, &s);
+  s.alloc_cnt -= before.alloc_cnt;
+  s.alloc_cycles -= before.alloc_cycles;
+  msg ("%zu allocations, %llu cycles each", s.alloc_cnt,
+       s.alloc_cnt ? s.alloc_cycles / s.alloc_cnt : 0);
+}
+
+/* Replaces random slots with new blocks ITERS times, starting a
+   process every SPAWN_EVERY iterations, then waits for the main
+   thread before freeing its slots. */
+static void
+worker (void *aux UNUSED)
+{
+  void *slots[SLOTS] = { NULL };
+  int i;
+
+  for (i = 0; i < ITERS; i++)
+    {
+      int slot = random_ulong () % SLOTS;
+
+      if (i % SPAWN_EVERY == 0
+          && thread_create ("process", PRI_DEFAULT, process,
+                            NULL) == TID_ERROR)
+        fail ("couldn't create process");
+      free (slots[slot]);
+      if ((slots[slot] = malloc (random_size ())) == NULL)
+        fail ("out of memory");
+      thread_yield ();
+    }
+
+  sema_up (&loaded);
+  sema_down (&go);
+  for (i = 0; i < SLOTS; i++)
+    free (slots[i]);
+  sema_up (&done);
+}
+
+/* Holds a large block across a yield, like a process loading its
+   image, then exits. */
+static void
+process (void *aux UNUSED)
+{
+  void *image = malloc ((1 + random_ulong () % 8) * PGSIZE);
+
+  if (image == NULL)
+    fail ("out of memory");
+  thread_yield ();
+  free (image);
+  sema_up (&done);
+}
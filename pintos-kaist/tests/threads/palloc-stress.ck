@@ -0,0 +1,28 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers on the last lines:
+#
+# (palloc-stress) 4 workers, 128 iterations each.
+# (palloc-stress) loaded: 31200 free pages, largest free block 1024 pages, 99% in blocks of 14 pages or more
+# (palloc-stress) All threads finished.
+# (palloc-stress) 1024 allocations, 412 cycles each
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "Missing fragmentation report\n"
+  if !grep (/loaded: \d+ free pages, largest free block \d+ pages, \d+% in blocks/,
+	    @output);
+fail "Missing allocation cost\n"
+  if !grep (/\d+ allocations, \d+ cycles each/, @output);
+fail "Threads did not finish\n"
+  if !grep (/All threads finished\./, @output);
+
+pass;
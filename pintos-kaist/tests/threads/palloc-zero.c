@@ -0,0 +1,70 @@
+/* Checks the pool of pre-zeroed pages: the idle thread fills it
+   while the main thread sleeps, PAL_ZERO allocations take its
+   pages and find them zeroed, and once it is empty PAL_ZERO
+   allocations zero their pages themselves. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_MAX 256                    /* Most pages to take. */
+
+/* Returns true if PAGE is all zeros. */
+static bool
+is_zeroed (const void *page)
+{
+  const uint64_t *p = page;
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *p; i++)
+    if (p[i] != 0)
+      return false;
+  return true;
+}
+
+void
+test_palloc_zero (void) 
+{
+  static void *pages[PAGE_MAX];
+  struct palloc_stats before, s;
+  bool all_zeroed = true;
+  size_t cnt, i;
+  void *page;
+
+  /* Let the idle thread run. */
+  timer_sleep (10);
+  palloc_get_stats (0, &before);
+  msg ("idle thread zeroed pages: %s",
+       before.zero_pages > 0 && before.zero_fills > 0 ? "yes" : "no");
+
+  for (cnt = 0; cnt < PAGE_MAX; cnt++)
+    {
+      palloc_get_stats (0, &s);
+      if (s.zero_pages == 0)
+        break;
+      pages[cnt] = palloc_get_page (PAL_ZERO | PAL_ASSERT);
+      if (!is_zeroed (pages[cnt]))
+        all_zeroed = false;
+    }
+  palloc_get_stats (0, &s);
+  msg ("pre-zeroed pages are zeroed: %s", all_zeroed ? "yes" : "no");
+  msg ("every page was taken pre-zeroed: %s",
+       s.zero_hits - before.zero_hits == cnt
+       && s.zero_misses == before.zero_misses ? "yes" : "no");
+
+  page = palloc_get_page (PAL_ZERO | PAL_ASSERT);
+  palloc_get_stats (0, &s);
+  msg ("pool empty, page zeroed on demand: %s",
+       is_zeroed (page) && s.zero_misses == before.zero_misses + 1
+       ? "yes" : "no");
+
+  palloc_free_page (page);
+  for (i = 0; i < cnt; i++)
+    palloc_free_page (pages[i]);
+  palloc_get_stats (0, &s);
+  msg ("free pages restored: %s",
+       s.free_pages == before.free_pages ? "yes" : "no");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-zero) begin
+(palloc-zero) idle thread zeroed pages: yes
+(palloc-zero) pre-zeroed pages are zeroed: yes
+(palloc-zero) every page was taken pre-zeroed: yes
+(palloc-zero) pool empty, page zeroed on demand: yes
+(palloc-zero) free pages restored: yes
+(palloc-zero) end
+EOF
+pass;
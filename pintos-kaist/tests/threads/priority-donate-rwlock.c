@@ -0,0 +1,110 @@
+/* The main thread and a second, sleeping thread both hold a
+   reader-writer lock for reading when a high-priority writer
+   blocks on it.  The writer must donate its priority to both
+   readers, and each reader must drop the donation as soon as it
+   releases its read lock.  The writer gets the lock once the last
+   reader is gone.
+
+   Then the main thread reads the rwlock again while a medium-
+   priority thread holding a lock waits to write it, and a high-
+   priority thread blocks on that lock.  The high thread's
+   donation must pass through the medium thread to the main
+   thread, which reads the rwlock the medium thread waits for. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+static thread_func medium_thread_func;
+static thread_func high_thread_func;
+
+static struct rwlock rwlock;
+static struct lock lock;
+static struct semaphore go;
+
+void
+test_priority_donate_rwlock (void) 
+{
+  struct rw_hold hold;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  sema_init (&go, 0);
+  rwlock_acquire_read (&rwlock, &hold);
+  thread_create ("reader", PRI_DEFAULT + 10, reader_thread_func, NULL);
+  thread_create ("writer", PRI_DEFAULT + 20, writer_thread_func, NULL);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 20, thread_get_priority ());
+
+  rwlock_release_read (&rwlock, &hold);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+
+  sema_up (&go);
+
+  lock_init (&lock);
+  rwlock_acquire_read (&rwlock, &hold);
+  thread_create ("medium", PRI_DEFAULT + 10, medium_thread_func, NULL);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  thread_create ("high", PRI_DEFAULT + 20, high_thread_func, NULL);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 20, thread_get_priority ());
+
+  rwlock_release_read (&rwlock, &hold);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+  msg ("Main thread finished.");
+}
+
+static void
+reader_thread_func (void *aux UNUSED) 
+{
+  struct rw_hold hold;
+
+  rwlock_acquire_read (&rwlock, &hold);
+  sema_down (&go);
+  msg ("Reader should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 20, thread_get_priority ());
+  rwlock_release_read (&rwlock, &hold);
+  msg ("Reader should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+}
+
+static void
+writer_thread_func (void *aux UNUSED) 
+{
+  rwlock_acquire_write (&rwlock);
+  msg ("Writer got the lock.");
+  rwlock_release_write (&rwlock);
+}
+
+static void
+medium_thread_func (void *aux UNUSED) 
+{
+  lock_acquire (&lock);
+  rwlock_acquire_write (&rwlock);
+  msg ("Medium thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 20, thread_get_priority ());
+  rwlock_release_write (&rwlock);
+  lock_release (&lock);
+  msg ("Medium thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+}
+
+static void
+high_thread_func (void *aux UNUSED) 
+{
+  lock_acquire (&lock);
+  msg ("High thread got the lock.");
+  lock_release (&lock);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rwlock) begin
+(priority-donate-rwlock) Main thread should have priority 51.  Actual priority: 51.
+(priority-donate-rwlock) Main thread should have priority 31.  Actual priority: 31.
+(priority-donate-rwlock) Reader should have priority 51.  Actual priority: 51.
+(priority-donate-rwlock) Writer got the lock.
+(priority-donate-rwlock) Reader should have priority 41.  Actual priority: 41.
+(priority-donate-rwlock) Main thread should have priority 41.  Actual priority: 41.
+(priority-donate-rwlock) Main thread should have priority 51.  Actual priority: 51.
+(priority-donate-rwlock) Medium thread should have priority 51.  Actual priority: 51.
+(priority-donate-rwlock) High thread got the lock.
+(priority-donate-rwlock) Medium thread should have priority 41.  Actual priority: 41.
+(priority-donate-rwlock) Main thread should have priority 31.  Actual priority: 31.
+(priority-donate-rwlock) Main thread finished.
+(priority-donate-rwlock) end
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Puts 30 threads of shuffled priorities to sleep on one
+   semaphore, then donates a high priority to the lowest of them
+   while it is still waiting.  Checks that the waiters wake up in
+   priority order and that the donation moves the recipient to
+   the front of the semaphore's queue. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define WAITER_CNT 30
+
+static thread_func waiter_thread;
+static thread_func donor_thread;
+static struct semaphore sema;
+static struct lock lock;
+
+void
+test_priority_sema_many (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&sema, 0);
+  lock_init (&lock);
+  thread_set_priority (PRI_MIN);
+
+  /* Each waiter preempts us, runs until it blocks on SEMA, and
+     only then lets us create the next one. */
+  for (i = 0; i < WAITER_CNT; i++) 
+    {
+      int priority = PRI_MIN + 1 + (i * 7) % WAITER_CNT;
+      char name[16];
+      snprintf (name, sizeof name, "priority %d", priority);
+      thread_create (name, priority, waiter_thread, NULL);
+    }
+
+  /* Blocks on LOCK, held by the lowest-priority waiter. */
+  thread_create ("donor", PRI_DEFAULT + 10, donor_thread, NULL);
+
+  for (i = 0; i < WAITER_CNT; i++)
+    sema_up (&sema);
+  msg ("Back in main thread.");
+}
+
+static void
+waiter_thread (void *aux UNUSED) 
+{
+  bool holder = thread_get_priority () == PRI_MIN + 1;
+
+  if (holder)
+    lock_acquire (&lock);
+  sema_down (&sema);
+  msg ("Thread %s woke up at priority %d.",
+       thread_name (), thread_get_priority ());
+  if (holder)
+    lock_release (&lock);
+}
+
+static void
+donor_thread (void *aux UNUSED) 
+{
+  lock_acquire (&lock);
+  msg ("Donor got the lock.");
+  lock_release (&lock);
+}
@@ -0,0 +1,41 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-sema-many) begin
+(priority-sema-many) Thread priority 1 woke up at priority 41.
+(priority-sema-many) Donor got the lock.
+(priority-sema-many) Thread priority 30 woke up at priority 30.
+(priority-sema-many) Thread priority 29 woke up at priority 29.
+(priority-sema-many) Thread priority 28 woke up at priority 28.
+(priority-sema-many) Thread priority 27 woke up at priority 27.
+(priority-sema-many) Thread priority 26 woke up at priority 26.
+(priority-sema-many) Thread priority 25 woke up at priority 25.
+(priority-sema-many) Thread priority 24 woke up at priority 24.
+(priority-sema-many) Thread priority 23 woke up at priority 23.
+(priority-sema-many) Thread priority 22 woke up at priority 22.
+(priority-sema-many) Thread priority 21 woke up at priority 21.
+(priority-sema-many) Thread priority 20 woke up at priority 20.
+(priority-sema-many) Thread priority 19 woke up at priority 19.
+(priority-sema-many) Thread priority 18 woke up at priority 18.
+(priority-sema-many) Thread priority 17 woke up at priority 17.
+(priority-sema-many) Thread priority 16 woke up at priority 16.
+(priority-sema-many) Thread priority 15 woke up at priority 15.
+(priority-sema-many) Thread priority 14 woke up at priority 14.
+(priority-sema-many) Thread priority 13 woke up at priority 13.
+(priority-sema-many) Thread priority 12 woke up at priority 12.
+(priority-sema-many) Thread priority 11 woke up at priority 11.
+(priority-sema-many) Thread priority 10 woke up at priority 10.
+(priority-sema-many) Thread priority 9 woke up at priority 9.
+(priority-sema-many) Thread priority 8 woke up at priority 8.
+(priority-sema-many) Thread priority 7 woke up at priority 7.
+(priority-sema-many) Thread priority 6 woke up at priority 6.
+(priority-sema-many) Thread priority 5 woke up at priority 5.
+(priority-sema-many) Thread priority 4 woke up at priority 4.
+(priority-sema-many) Thread priority 3 woke up at priority 3.
+(priority-sema-many) Thread priority 2 woke up at priority 2.
+(priority-sema-many) Back in main thread.
+(priority-sema-many) end
+EOF
+pass;
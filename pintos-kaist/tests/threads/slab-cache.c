@@ -0,0 +1,74 @@
+/* Checks a slab cache: objects come constructed and keep their
+   constructed state across free and reuse, consecutive slabs are
+   colored differently, and slab_reclaim() gives back the pages
+   of empty slabs. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define OBJ_MAGIC 0x0b1ec7ed
+#define SLAB_CNT 3                      /* Slabs to fill. */
+#define OBJ_MAX 256                     /* Most objects to fill them. */
+
+struct obj
+  {
+    unsigned magic;                     /* Set by the constructor. */
+    char data[96];
+  };
+
+static int ctor_cnt;
+
+static void
+ctor (void *obj_)
+{
+  struct obj *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+  ctor_cnt++;
+}
+
+void
+test_slab_cache (void) 
+{
+  static struct obj *objs[OBJ_MAX];
+  struct slab_cache *cache;
+  struct slab_stats s;
+  size_t cnt, i;
+
+  cache = slab_cache_create ("test", sizeof (struct obj), ctor);
+  slab_get_stats (cache, &s);
+  msg ("%zu-byte objects, more than %d per slab: %s", s.obj_size,
+       PGSIZE / 128, s.objs_per_slab > PGSIZE / 128 ? "yes" : "no");
+
+  cnt = SLAB_CNT * s.objs_per_slab;
+  ASSERT (cnt <= OBJ_MAX);
+  for (i = 0; i < cnt; i++)
+    {
+      objs[i] = slab_alloc (cache);
+      if (objs[i] == NULL)
+        fail ("out of memory");
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %zu not constructed", i);
+    }
+  slab_get_stats (cache, &s);
+  msg ("%zu slabs, all objects in use: %s", s.slab_cnt,
+       s.in_use == cnt ? "yes" : "no");
+  msg ("constructed once each: %s", ctor_cnt == (int) cnt ? "yes" : "no");
+  msg ("first two slabs colored differently: %s",
+       pg_ofs (objs[0]) != pg_ofs (objs[s.objs_per_slab]) ? "yes" : "no");
+
+  for (i = 0; i < cnt; i++)
+    slab_free (cache, objs[i]);
+  objs[0] = slab_alloc (cache);
+  msg ("reused object keeps its state: %s",
+       objs[0]->magic == OBJ_MAGIC && ctor_cnt == (int) cnt ? "yes" : "no");
+  slab_free (cache, objs[0]);
+
+  msg ("reclaimed at least %d pages: %s", SLAB_CNT,
+       slab_reclaim () >= SLAB_CNT ? "yes" : "no");
+  slab_get_stats (cache, &s);
+  msg ("%zu slabs, %zu objects in use", s.slab_cnt, s.in_use);
+}
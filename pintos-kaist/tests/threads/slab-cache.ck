@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) 104-byte objects, more than 32 per slab: yes
+(slab-cache) 3 slabs, all objects in use: yes
+(slab-cache) constructed once each: yes
+(slab-cache) first two slabs colored differently: yes
+(slab-cache) reused object keeps its state: yes
+(slab-cache) reclaimed at least 3 pages: yes
+(slab-cache) 0 slabs, 0 objects in use
+(slab-cache) end
+EOF
+pass;
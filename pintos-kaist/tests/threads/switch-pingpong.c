@@ -0,0 +1,68 @@
+/* Context switch microbenchmark.  The main thread and a partner
+   thread of the same priority hand control back and forth
+   through two semaphores ROUND_TRIPS times, two thread switches
+   per round trip, and the test reports the switch rate and the
+   average number of TSC cycles per switch. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define ROUND_TRIPS 20000
+
+struct pingpong 
+  {
+    struct semaphore ping;      /* Upped by the main thread. */
+    struct semaphore pong;      /* Upped by the partner. */
+  };
+
+static thread_func partner;
+
+void
+test_switch_pingpong (void) 
+{
+  struct pingpong pp;
+  uint64_t start_cycles, cycles;
+  int64_t start_ticks, ticks;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&pp.ping, 0);
+  sema_init (&pp.pong, 0);
+  thread_create ("partner", PRI_DEFAULT, partner, &pp);
+
+  start_ticks = timer_ticks ();
+  start_cycles = rdtsc ();
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_up (&pp.ping);
+      sema_down (&pp.pong);
+    }
+  cycles = rdtsc () - start_cycles;
+  ticks = timer_elapsed (start_ticks);
+
+  msg ("%d switches in %lld ticks: %lld switches per second, "
+       "%llu cycles per switch",
+       ROUND_TRIPS * 2, ticks,
+       ticks > 0 ? (long long) ROUND_TRIPS * 2 * TIMER_FREQ / ticks : 0,
+       cycles / (ROUND_TRIPS * 2));
+}
+
+static void
+partner (void *pp_) 
+{
+  struct pingpong *pp = pp_;
+  int i;
+
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_down (&pp->ping);
+      sema_up (&pp->pong);
+    }
+}
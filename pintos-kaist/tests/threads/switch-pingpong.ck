@@ -0,0 +1,20 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers:
+#
+# (switch-pingpong) 40000 switches in 41 ticks: 97560 switches per second, 1530 cycles per switch
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "missing switch rate\n"
+  if !grep (/40000 switches in \d+ ticks: \d+ switches per second/, @output);
+
+pass;
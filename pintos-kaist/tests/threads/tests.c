@@ -17,6 +17,9 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-scale", test_alarm_scale},
+    {"alarm-tickless", test_alarm_tickless},
+    {"switch-pingpong", test_switch_pingpong},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -28,6 +31,18 @@ static const struct test tests[] =
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
+    {"priority-sema-many", test_priority_sema_many},
+    {"futex-handoff", test_futex_handoff},
+    {"priority-donate-rwlock", test_priority_donate_rwlock},
+    {"thread-bomb", test_thread_bomb},
+    {"deadline-hogs", test_deadline_hogs},
+    {"workqueue", test_workqueue},
+    {"palloc-stress", test_palloc_stress},
+    {"malloc-churn", test_malloc_churn},
+    {"slab-cache", test_slab_cache},
+    {"malloc-large", test_malloc_large},
+    {"palloc-zero", test_palloc_zero},
+    {"tlb-reach", test_tlb_reach},
     {"priority-condvar", test_priority_condvar},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
@@ -38,6 +53,7 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-scale", test_mlfqs_scale},
   };
 
 static const char *test_name;
@@ -11,6 +11,9 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_scale;
+extern test_func test_alarm_tickless;
+extern test_func test_switch_pingpong;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -22,6 +25,18 @@ extern test_func test_priority_donate_chain;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
+extern test_func test_priority_sema_many;
+extern test_func test_futex_handoff;
+extern test_func test_priority_donate_rwlock;
+extern test_func test_thread_bomb;
+extern test_func test_deadline_hogs;
+extern test_func test_workqueue;
+extern test_func test_palloc_stress;
+extern test_func test_malloc_churn;
+extern test_func test_slab_cache;
+extern test_func test_malloc_large;
+extern test_func test_palloc_zero;
+extern test_func test_tlb_reach;
 extern test_func test_priority_condvar;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
@@ -32,6 +47,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_scale;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
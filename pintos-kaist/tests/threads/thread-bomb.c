@@ -0,0 +1,66 @@
+/* Measures how fast threads can be created and destroyed.  For
+   one second, repeatedly grows a binary tree of threads, DEPTH
+   levels deep, in which every thread creates its two children
+   and exits without waiting for them, fork-bomb style.  Reports
+   the number of threads created per second, which mostly shows
+   the cost of allocating and freeing thread pages. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define DEPTH 4                         /* Levels below the root. */
+#define TREE_SIZE ((2 << DEPTH) - 1)    /* Threads per tree. */
+
+static struct semaphore done;           /* Upped by each thread. */
+static thread_func bomb;
+
+void
+test_thread_bomb (void) 
+{
+  int64_t start, elapsed;
+  long long trees = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  msg ("Each tree has %d threads.", TREE_SIZE);
+
+  start = timer_ticks ();
+  do
+    {
+      if (thread_create ("bomb", PRI_DEFAULT, bomb, (void *) 0) == TID_ERROR)
+        fail ("couldn't create root thread");
+      for (i = 0; i < TREE_SIZE; i++)
+        sema_down (&done);
+      trees++;
+    }
+  while ((elapsed = timer_elapsed (start)) < TIMER_FREQ);
+
+  msg ("%lld threads in %lld ticks: %lld threads per second",
+       trees * TREE_SIZE, elapsed, trees * TREE_SIZE * TIMER_FREQ / elapsed);
+}
+
+/* Creates two children one level further down, unless at the
+   bottom of the tree, then exits. */
+static void
+bomb (void *level_) 
+{
+  int level = (int) (intptr_t) level_;
+
+  if (level < DEPTH)
+    {
+      int i;
+
+      for (i = 0; i < 2; i++)
+        if (thread_create ("bomb", PRI_DEFAULT, bomb,
+                           (void *) (intptr_t) (level + 1)) == TID_ERROR)
+          fail ("couldn't create thread at level %d", level + 1);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers:
+#
+# (thread-bomb) Each tree has 31 threads.
+# (thread-bomb) 6231 threads in 100 ticks: 62310 threads per second
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "Missing thread creation rate\n"
+  if !grep (/\d+ threads in \d+ ticks: \d+ threads per second/, @output);
+
+pass;
@@ -0,0 +1,81 @@
+/* Measures how the kernel's 2 MB mappings of physical memory
+   stretch the TLB's reach.  Takes BLOCK_CNT blocks of
+   PALLOC_MAX_PAGES pages, checks that they are mapped with 2 MB
+   pages, and reports the cycles per page when one byte of every
+   page is touched, pass after pass.  Then splits those mappings
+   into 4 kB pages and measures again. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define BLOCK_CNT 8                     /* Blocks to touch. */
+#define PASS_CNT 16                     /* Passes over all of them. */
+
+static uint8_t *blocks[BLOCK_CNT];
+
+/* Returns true if every 2 MB region of the blocks is mapped with
+   a large page. */
+static bool
+all_large (void)
+{
+  size_t i, ofs;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    for (ofs = 0; ofs < PALLOC_MAX_PAGES * PGSIZE; ofs += LARGE_PGSIZE)
+      {
+        uint64_t *pde = pml4_pde_walk (base_pml4,
+                                       (uint64_t) blocks[i] + ofs, 0);
+        if (pde == NULL || !is_large_pte (pde))
+          return false;
+      }
+  return true;
+}
+
+/* Returns the cycles per page for touching every page of the
+   blocks PASS_CNT times. */
+static uint64_t
+touch_pages (void)
+{
+  uint64_t start = rdtsc ();
+  size_t pass, i, ofs;
+
+  for (pass = 0; pass < PASS_CNT; pass++)
+    for (i = 0; i < BLOCK_CNT; i++)
+      for (ofs = 0; ofs < PALLOC_MAX_PAGES * PGSIZE; ofs += PGSIZE)
+        blocks[i][ofs]++;
+  return (rdtsc () - start) / (PASS_CNT * BLOCK_CNT * PALLOC_MAX_PAGES);
+}
+
+void
+test_tlb_reach (void) 
+{
+  size_t i, ofs;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      blocks[i] = palloc_get_multiple (PAL_ZERO, PALLOC_MAX_PAGES);
+      if (blocks[i] == NULL)
+        fail ("couldn't allocate block %zu", i);
+    }
+
+  msg ("mapped with 2 MB pages: %s", all_large () ? "yes" : "no");
+  msg ("2 MB pages: %llu cycles per page", touch_pages ());
+
+  /* Walking down to the page table splits each large page. */
+  for (i = 0; i < BLOCK_CNT; i++)
+    for (ofs = 0; ofs < PALLOC_MAX_PAGES * PGSIZE; ofs += LARGE_PGSIZE)
+      if (pml4e_walk (base_pml4, (uint64_t) blocks[i] + ofs, 1) == NULL)
+        fail ("couldn't split large page");
+  msg ("mapped with 2 MB pages after splitting: %s",
+       all_large () ? "yes" : "no");
+  msg ("4 kB pages: %llu cycles per page", touch_pages ());
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    palloc_free_multiple (blocks[i], PALLOC_MAX_PAGES);
+  msg ("done");
+}
@@ -0,0 +1,31 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers:
+#
+# (tlb-reach) mapped with 2 MB pages: yes
+# (tlb-reach) 2 MB pages: 35 cycles per page
+# (tlb-reach) mapped with 2 MB pages after splitting: no
+# (tlb-reach) 4 kB pages: 52 cycles per page
+# (tlb-reach) done
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "Memory not mapped with 2 MB pages\n"
+  if !grep (/mapped with 2 MB pages: yes/, @output);
+fail "Large pages not split\n"
+  if !grep (/mapped with 2 MB pages after splitting: no/, @output);
+foreach my $size ('2 MB', '4 kB') {
+    fail "Missing cost with $size pages\n"
+      if !grep (/$size pages: \d+ cycles per page/, @output);
+}
+fail "Test did not finish\n" if !grep (/\(tlb-reach\) done/, @output);
+
+pass;
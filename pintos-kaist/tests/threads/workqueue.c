@@ -0,0 +1,95 @@
+/* Checks deferred work: items of each priority run in the order
+   they were queued, an item queued again before it starts runs
+   only once, an item may queue itself again, and WORK_NORMAL
+   items run in a worker thread where they may sleep. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define ITEM_CNT 4
+#define REQUEUE_CNT 5
+
+static struct semaphore done;
+static int order[ITEM_CNT];
+static int order_cnt;
+static int requeue_cnt;
+static bool slept_in_worker;
+
+static work_func record, requeue, sleeper;
+
+void
+test_workqueue (void) 
+{
+  struct work items[ITEM_CNT];
+  struct work again, sleepy;
+  enum intr_level old_level;
+  int i;
+
+  sema_init (&done, 0);
+
+  /* Run at the worker's priority, with interrupts off, so that
+     no item runs before we wait for them. */
+  thread_set_priority (PRI_MAX);
+  old_level = intr_disable ();
+  for (i = 0; i < ITEM_CNT; i++) 
+    {
+      work_init (&items[i], record, (void *) (intptr_t) i);
+      work_queue (&items[i], i % 2 ? WORK_HIGH : WORK_NORMAL);
+    }
+  if (work_queue (&items[0], WORK_NORMAL))
+    fail ("queued an item that is still pending");
+  intr_set_level (old_level);
+  for (i = 0; i < ITEM_CNT; i++)
+    sema_down (&done);
+  msg ("High priority items ran in order %d, %d.", order[0], order[1]);
+  msg ("Normal priority items ran in order %d, %d.", order[2], order[3]);
+
+  work_init (&again, requeue, &again);
+  work_queue (&again, WORK_HIGH);
+  sema_down (&done);
+  msg ("Item ran %d times by queueing itself.", requeue_cnt);
+
+  work_init (&sleepy, sleeper, NULL);
+  work_queue (&sleepy, WORK_NORMAL);
+  sema_down (&done);
+  if (!slept_in_worker)
+    fail ("normal priority work did not run in the worker thread");
+  msg ("Normal priority item slept in the worker thread.");
+}
+
+/* Records that item AUX ran. */
+static void
+record (void *aux) 
+{
+  order[order_cnt++] = (int) (intptr_t) aux;
+  sema_up (&done);
+}
+
+/* Queues itself, AUX, again until it has run REQUEUE_CNT times. */
+static void
+requeue (void *aux) 
+{
+  if (++requeue_cnt < REQUEUE_CNT)
+    {
+      if (!work_queue (aux, WORK_HIGH))
+        fail ("couldn't queue a running item again");
+    }
+  else
+    sema_up (&done);
+}
+
+/* Sleeps for a tick. */
+static void
+sleeper (void *aux UNUSED) 
+{
+  timer_sleep (1);
+  slept_in_worker = !strcmp (thread_name (), "kworker");
+  sema_up (&done);
+}
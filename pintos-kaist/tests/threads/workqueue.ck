@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) High priority items ran in order 1, 3.
+(workqueue) Normal priority items ran in order 0, 2.
+(workqueue) Item ran 5 times by queueing itself.
+(workqueue) Normal priority item slept in the worker thread.
+(workqueue) end
+EOF
+pass;
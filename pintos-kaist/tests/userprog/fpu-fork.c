@@ -0,0 +1,67 @@
+/* Forks a child, then has the parent and the child each sum a
+   long series in the x87 FPU registers at the same time, so that
+   timer interrupts switch between them while both have live FPU
+   state.  Each checks its own result, which would come out wrong
+   if the kernel did not save and restore FPU state across
+   context switches.  The sums are integers small enough that
+   the x87 computes them exactly. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define TERMS 3000000
+
+/* Returns K + 2K + ... + N*K, computed on the x87 register stack
+   without touching memory inside the loop. */
+static long long
+x87_series (long long n, long long k) 
+{
+  long long sum;
+
+  asm volatile ("fildq %[k]\n\t"               /* st0 = k */
+                "fldz\n\t"                     /* st0 = term, st1 = k */
+                "fldz\n"                       /* st0 = sum */
+                "1:\n\t"
+                "fxch %%st(1)\n\t"             /* st0 = term, st1 = sum */
+                "fadd %%st(2), %%st\n\t"       /* term += k */
+                "fadd %%st, %%st(1)\n\t"       /* sum += term */
+                "fxch %%st(1)\n\t"             /* st0 = sum, st1 = term */
+                "dec %[n]\n\t"
+                "jnz 1b\n\t"
+                "fistpq %[sum]\n\t"
+                "fstp %%st(0)\n\t"
+                "fstp %%st(0)\n\t"
+                : [sum] "=m" (sum), [n] "+r" (n)
+                : [k] "m" (k)
+                : "cc", "memory");
+  return sum;
+}
+
+/* Runs the series with multiplier K and returns true if the
+   result is correct. */
+static bool
+check_series (long long k) 
+{
+  return x87_series (TERMS, k) == k * TERMS * (TERMS + 1LL) / 2;
+}
+
+void
+test_main (void) 
+{
+  int pid;
+
+  /* Use the FPU before forking, so the child inherits live state. */
+  CHECK (check_series (1), "series before fork");
+
+  if ((pid = fork ("child"))) 
+    {
+      bool ok = check_series (3);
+      msg ("child exit status is %d", wait (pid));
+      if (!ok)
+        fail ("parent's series is wrong");
+      msg ("parent's series is correct");
+    }
+  else
+    exit (check_series (7) ? 0 : 1);
+}
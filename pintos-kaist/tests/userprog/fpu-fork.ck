@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu-fork) begin
+(fpu-fork) series before fork
+child: exit(0)
+(fpu-fork) child exit status is 0
+(fpu-fork) parent's series is correct
+(fpu-fork) end
+fpu-fork: exit(0)
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Checks the futex system calls and the user-space mutex built on
+   them, and measures the uncontended fast path.  Taking and
+   dropping a mutex nobody else wants must not enter the kernel,
+   so a lock/unlock pair should cost much less than a single
+   futex system call. */
+
+#include <mutex.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ITERATIONS 10000
+
+void
+test_main (void) 
+{
+  static struct mutex m = MUTEX_INITIALIZER;
+  static struct condvar cv = CONDVAR_INITIALIZER;
+  static int word = 5;
+  uint64_t start, lock_cycles, syscall_cycles;
+  int i;
+
+  CHECK (futex_wait (&word, 6) == -1,
+         "futex_wait on a changed word returns at once");
+  CHECK (futex_wake (&word, 1) == 0, "futex_wake with no sleepers wakes 0");
+
+  mutex_lock (&m);
+  CHECK (!mutex_trylock (&m), "trylock fails on a held mutex");
+  condvar_signal (&cv, &m);
+  mutex_unlock (&m);
+  CHECK (mutex_trylock (&m), "trylock succeeds on a free mutex");
+  mutex_unlock (&m);
+
+  start = rdtsc ();
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      mutex_lock (&m);
+      mutex_unlock (&m);
+    }
+  lock_cycles = (rdtsc () - start) / ITERATIONS;
+
+  start = rdtsc ();
+  for (i = 0; i < ITERATIONS; i++)
+    futex_wake (&word, 1);
+  syscall_cycles = (rdtsc () - start) / ITERATIONS;
+
+  msg ("uncontended lock/unlock: %llu cycles, futex system call: %llu cycles",
+       lock_cycles, syscall_cycles);
+  CHECK (lock_cycles < syscall_cycles,
+         "uncontended lock/unlock stays out of the kernel");
+}
@@ -0,0 +1,36 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers on the cycle count line:
+#
+# (futex-mutex) begin
+# (futex-mutex) futex_wait on a changed word returns at once
+# (futex-mutex) futex_wake with no sleepers wakes 0
+# (futex-mutex) trylock fails on a held mutex
+# (futex-mutex) trylock succeeds on a free mutex
+# (futex-mutex) uncontended lock/unlock: 31 cycles, futex system call: 812 cycles
+# (futex-mutex) uncontended lock/unlock stays out of the kernel
+# (futex-mutex) end
+# futex-mutex: exit(0)
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+@output = grep (!/^\(futex-mutex\) uncontended lock\/unlock: \d+ cycles/,
+                @output);
+compare_output ("run", \@output, [<<'EOF']);
+(futex-mutex) begin
+(futex-mutex) futex_wait on a changed word returns at once
+(futex-mutex) futex_wake with no sleepers wakes 0
+(futex-mutex) trylock fails on a held mutex
+(futex-mutex) trylock succeeds on a free mutex
+(futex-mutex) uncontended lock/unlock stays out of the kernel
+(futex-mutex) end
+futex-mutex: exit(0)
+EOF
+pass;
@@ -0,0 +1,165 @@
+/* Checks the io_ring system calls and measures 512-byte random
+   reads three ways: with seek() and read() system calls, in
+   batches through a ring that io_ring_enter() drains, and through
+   a ring that a kernel thread polls. */
+
+#include <random.h>
+#include <ring.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_SIZE 512
+#define BLOCK_CNT 128                   /* Blocks in the file. */
+#define READ_CNT 1024                   /* Reads per run. */
+#define BATCH 32                        /* Reads per submission. */
+
+static char buf[BATCH][BLOCK_SIZE];
+static int blocks[READ_CNT];
+
+/* Fails unless BLOCK holds the data of block number B. */
+static void
+check_block (const char *block, int b)
+{
+  if (block[0] != (char) b || block[BLOCK_SIZE - 1] != (char) b)
+    fail ("block %d read back wrong", b);
+}
+
+/* Submits the SQEs filled so far, waits for all CNT of them, and
+   returns the first CQE's result. */
+static int
+run_batch (struct io_ring *ring, unsigned cnt)
+{
+  struct io_cqe *cqe;
+  int res = 0;
+  unsigned i;
+
+  if (io_ring_submit (ring, cnt) < 0)
+    fail ("io_ring_submit");
+  for (i = 0; i < cnt; i++)
+    {
+      if ((cqe = io_ring_peek_cqe (ring)) == NULL)
+        fail ("missing completion");
+      if (i == 0)
+        res = cqe->res;
+      io_ring_cqe_seen (ring);
+    }
+  return res;
+}
+
+/* Reads every block of BLOCKS through RING, BATCH at a time, and
+   returns the cycles spent per read. */
+static uint64_t
+ring_reads (struct io_ring *ring, int fd)
+{
+  uint64_t start = rdtsc ();
+  int i, j;
+
+  for (i = 0; i < READ_CNT; i += BATCH)
+    {
+      struct io_cqe *cqe;
+
+      for (j = 0; j < BATCH; j++)
+        {
+          struct io_sqe *sqe = io_ring_get_sqe (ring);
+          io_ring_prep_read (sqe, fd, buf[j], BLOCK_SIZE,
+                             blocks[i + j] * BLOCK_SIZE);
+          sqe->user_data = j;
+        }
+      io_ring_submit (ring, BATCH);
+      for (j = 0; j < BATCH; j++)
+        {
+          if ((cqe = io_ring_peek_cqe (ring)) == NULL)
+            fail ("missing completion");
+          if (cqe->res != BLOCK_SIZE)
+            fail ("ring read returned %d", cqe->res);
+          check_block (buf[cqe->user_data], blocks[i + cqe->user_data]);
+          io_ring_cqe_seen (ring);
+        }
+    }
+  return (rdtsc () - start) / READ_CNT;
+}
+
+void
+test_main (void)
+{
+  static const char hello[] = "(io-ring) hello from the ring\n";
+  struct io_ring *ring;
+  struct io_sqe *sqe;
+  uint64_t start, plain_cycles, ring_cycles;
+  pid_t pid;
+  int fd, ring_fd;
+  int i;
+
+  /* Block B of the file is filled with byte B. */
+  CHECK (create ("data", BLOCK_CNT * BLOCK_SIZE), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      memset (buf[0], i, BLOCK_SIZE);
+      write (fd, buf[0], BLOCK_SIZE);
+    }
+  random_init (0);
+  for (i = 0; i < READ_CNT; i++)
+    blocks[i] = random_ulong () % BLOCK_CNT;
+
+  CHECK (io_ring_setup (BATCH + 1, 0) == NULL, "refuse ring size not a power of 2");
+  CHECK ((ring = io_ring_setup (BATCH, 0)) != NULL, "set up ring");
+  CHECK (io_ring_setup (BATCH, 0) == NULL, "refuse second ring");
+
+  io_ring_prep_nop (io_ring_get_sqe (ring));
+  CHECK (run_batch (ring, 1) == 0, "nop");
+  io_ring_prep_write (io_ring_get_sqe (ring), 1, hello, sizeof hello - 1, -1);
+  CHECK (run_batch (ring, 1) == sizeof hello - 1, "write to console");
+  io_ring_prep_open (io_ring_get_sqe (ring), "data");
+  CHECK ((ring_fd = run_batch (ring, 1)) > 1, "open \"data\"");
+  io_ring_prep_read (io_ring_get_sqe (ring), ring_fd, buf[0], BLOCK_SIZE,
+                     7 * BLOCK_SIZE);
+  CHECK (run_batch (ring, 1) == BLOCK_SIZE, "read block 7");
+  check_block (buf[0], 7);
+  io_ring_prep_read (io_ring_get_sqe (ring), ring_fd, (void *) test_main,
+                     BLOCK_SIZE, 0);
+  CHECK (run_batch (ring, 1) == -1, "refuse read into code");
+  io_ring_prep_close (io_ring_get_sqe (ring), ring_fd);
+  CHECK (run_batch (ring, 1) == 0, "close");
+  io_ring_prep_close (io_ring_get_sqe (ring), ring_fd);
+  CHECK (run_batch (ring, 1) == -1, "close again");
+  quiet = true;
+  for (i = 0; i < BATCH; i++)
+    {
+      CHECK ((sqe = io_ring_get_sqe (ring)) != NULL, "get SQE %d", i);
+      io_ring_prep_nop (sqe);
+    }
+  quiet = false;
+  CHECK (io_ring_get_sqe (ring) == NULL, "SQ is full");
+  CHECK (run_batch (ring, BATCH) == 0, "run full SQ");
+
+  start = rdtsc ();
+  for (i = 0; i < READ_CNT; i++)
+    {
+      seek (fd, blocks[i] * BLOCK_SIZE);
+      if (read (fd, buf[0], BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("read");
+      check_block (buf[0], blocks[i]);
+    }
+  plain_cycles = (rdtsc () - start) / READ_CNT;
+  ring_cycles = ring_reads (ring, fd);
+  msg ("per read: seek+read %llu cycles, ring %llu cycles",
+       plain_cycles, ring_cycles);
+  msg ("random reads through ring");
+
+  /* fork() leaves the ring out of the child, which sets up a
+     polled one of its own. */
+  if ((pid = fork ("child")) == 0)
+    {
+      CHECK ((ring = io_ring_setup (BATCH, IO_RING_SQPOLL)) != NULL,
+             "set up polled ring");
+      msg ("per read: polled ring %llu cycles", ring_reads (ring, fd));
+      msg ("random reads through polled ring");
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+  close (fd);
+}
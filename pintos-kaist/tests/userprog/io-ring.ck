@@ -0,0 +1,43 @@
+# -*- perl -*-
+
+# The expected output looks like this, with machine-dependent
+# numbers on the cycle count lines:
+#
+# (io-ring) per read: seek+read 91234 cycles, ring 80123 cycles
+# (io-ring) per read: polled ring 79012 cycles
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+@output = grep (!/^\(io-ring\) per read: .*\d+ cycles/, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(io-ring) begin
+(io-ring) create "data"
+(io-ring) open "data"
+(io-ring) refuse ring size not a power of 2
+(io-ring) set up ring
+(io-ring) refuse second ring
+(io-ring) nop
+(io-ring) hello from the ring
+(io-ring) write to console
+(io-ring) open "data"
+(io-ring) read block 7
+(io-ring) refuse read into code
+(io-ring) close
+(io-ring) close again
+(io-ring) SQ is full
+(io-ring) run full SQ
+(io-ring) random reads through ring
+(io-ring) set up polled ring
+(io-ring) random reads through polled ring
+child: exit(0)
+(io-ring) wait for child
+(io-ring) end
+io-ring: exit(0)
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Checks the admission control of the deadline scheduling class.
+   Parameters must satisfy 0 < runtime <= deadline <= period, and
+   the bandwidths reserved on the CPU, runtime / period, must not
+   add up to more than 95%.  A process's reservation is released
+   when it exits. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t pid;
+
+  CHECK (!sched_deadline (5, 2, 10), "reject deadline shorter than runtime");
+  CHECK (!sched_deadline (2, 10, 5), "reject period shorter than deadline");
+  CHECK (!sched_deadline (10, 10, 10), "reject 100%% bandwidth");
+  CHECK (sched_deadline (4, 10, 10), "admit 40%% bandwidth");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      CHECK (!sched_deadline (6, 10, 10), "child: reject another 60%%");
+      CHECK (sched_deadline (5, 20, 20), "child: admit another 25%%");
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+
+  CHECK (sched_deadline (11, 20, 20), "replace 40%% by 55%% after child exit");
+  CHECK (sched_deadline (0, 0, 0), "leave the deadline class");
+  CHECK (sched_deadline (19, 20, 20), "admit 95%% bandwidth");
+  CHECK (sched_deadline (0, 0, 0), "leave the deadline class");
+}
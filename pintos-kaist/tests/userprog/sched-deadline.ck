@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-deadline) begin
+(sched-deadline) reject deadline shorter than runtime
+(sched-deadline) reject period shorter than deadline
+(sched-deadline) reject 100% bandwidth
+(sched-deadline) admit 40% bandwidth
+(sched-deadline) child: reject another 60%
+(sched-deadline) child: admit another 25%
+child: exit(0)
+(sched-deadline) wait for child
+(sched-deadline) replace 40% by 55% after child exit
+(sched-deadline) leave the deadline class
+(sched-deadline) admit 95% bandwidth
+(sched-deadline) leave the deadline class
+(sched-deadline) end
+sched-deadline: exit(0)
+EOF
+pass;
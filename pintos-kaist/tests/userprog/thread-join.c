@@ -0,0 +1,89 @@
+/* Starts threads in this process and checks that they share its
+   memory and open files, that thread_join() returns their exit
+   status once, and that the stacks of joined threads are
+   reused. */
+
+#include <mutex.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/userprog/sample.inc"
+
+#define THREAD_CNT 4
+#define ADD_CNT 1000
+
+static struct mutex mutex = MUTEX_INITIALIZER;
+static int counter;
+
+/* Adds to the shared counter under the mutex, with a system call
+   in between to let the other threads at it. */
+static int
+add (void *aux)
+{
+  int i;
+
+  for (i = 0; i < ADD_CNT; i++)
+    {
+      mutex_lock (&mutex);
+      counter++;
+      mutex_unlock (&mutex);
+      if (i % 100 == 0)
+        filesize (0);
+    }
+  return (int) (intptr_t) aux + 10;
+}
+
+static int
+quit (void *aux UNUSED)
+{
+  thread_exit (42);
+}
+
+static int
+open_sample (void *aux UNUSED)
+{
+  return open ("sample.txt");
+}
+
+static int
+nop (void *aux)
+{
+  return (int) (intptr_t) aux;
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  tid_t tid;
+  int fd;
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK ((tids[i] = thread_create (add, (void *) (intptr_t) i))
+           != TID_ERROR, "create thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == i + 10, "join thread %d", i);
+  CHECK (counter == THREAD_CNT * ADD_CNT, "counter is %d", counter);
+  CHECK (thread_join (tids[0]) == -1, "join thread 0 again");
+  CHECK (thread_join (-1) == -1, "join bad tid");
+
+  tid = thread_create (quit, NULL);
+  CHECK (thread_join (tid) == 42, "join thread that called thread_exit");
+
+  tid = thread_create (open_sample, NULL);
+  CHECK ((fd = thread_join (tid)) > 1, "open in thread");
+  CHECK (filesize (fd) == sizeof sample - 1, "use its fd in main thread");
+  close (fd);
+
+  quiet = true;
+  for (i = 0; i < 40; i++)
+    {
+      CHECK ((tid = thread_create (nop, (void *) (intptr_t) i))
+             != TID_ERROR, "create thread %d", i);
+      CHECK (thread_join (tid) == i, "join thread %d", i);
+    }
+  quiet = false;
+  msg ("created and joined 40 threads in turn");
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-join) begin
+(thread-join) create thread 0
+(thread-join) create thread 1
+(thread-join) create thread 2
+(thread-join) create thread 3
+(thread-join) join thread 0
+(thread-join) join thread 1
+(thread-join) join thread 2
+(thread-join) join thread 3
+(thread-join) counter is 4000
+(thread-join) join thread 0 again
+(thread-join) join bad tid
+(thread-join) join thread that called thread_exit
+(thread-join) open in thread
+(thread-join) use its fd in main thread
+(thread-join) created and joined 40 threads in turn
+(thread-join) end
+thread-join: exit(0)
+EOF
+pass;
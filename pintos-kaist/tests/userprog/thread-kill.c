@@ -0,0 +1,69 @@
+/* exit() in one thread ends the whole process: the main thread,
+   blocked in thread_join(), a thread blocked in condvar_wait(),
+   and a thread that spins in user mode without ever entering the
+   kernel all die, and the process reports a single exit
+   status. */
+
+#include <syscall.h>
+#include <mutex.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct mutex mutex = MUTEX_INITIALIZER;
+static struct condvar cond = CONDVAR_INITIALIZER;
+static bool sleeping;
+
+static int
+spin (void *aux UNUSED)
+{
+  volatile int i = 0;
+
+  for (;;)
+    i++;
+  NOT_REACHED ();
+}
+
+/* Waits on a condition variable that is never signaled. */
+static int
+sleeper (void *aux UNUSED)
+{
+  mutex_lock (&mutex);
+  sleeping = true;
+  for (;;)
+    condvar_wait (&cond, &mutex);
+  NOT_REACHED ();
+}
+
+static int
+quit (void *aux UNUSED)
+{
+  exit (57);
+}
+
+void
+test_main (void)
+{
+  pid_t pid;
+
+  if ((pid = fork ("child")) == 0)
+    {
+      tid_t spinner = thread_create (spin, NULL);
+
+      /* Once the sleeper has set SLEEPING and let go of the mutex,
+         it is in condvar_wait(). */
+      thread_create (sleeper, NULL);
+      for (;;)
+        {
+          mutex_lock (&mutex);
+          if (sleeping)
+            break;
+          mutex_unlock (&mutex);
+        }
+      mutex_unlock (&mutex);
+
+      thread_create (quit, NULL);
+      thread_join (spinner);
+      fail ("main thread survived exit()");
+    }
+  CHECK (wait (pid) == 57, "wait for child");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-kill) begin
+child: exit(57)
+(thread-kill) wait for child
+(thread-kill) end
+thread-kill: exit(0)
+EOF
+pass;
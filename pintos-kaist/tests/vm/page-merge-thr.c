@@ -0,0 +1,14 @@
+/* Like page-merge-par, but each chunk is sorted by a thread that
+   shares the data with the main thread, instead of by a child
+   process that gets it through a file.  Comparing the run times
+   of the two tests shows what fork, exec and the file copies
+   cost. */
+
+#include "tests/main.h"
+#include "tests/vm/parallel-merge.h"
+
+void
+test_main (void) 
+{
+  parallel_merge_threads ();
+}
@@ -1,7 +1,11 @@
 /* Generates about 1 MB of random data that is then divided into
    16 chunks.  A separate subprocess sorts each chunk; the
    subprocesses run in parallel.  Then we merge the chunks and
-   verify that the result is what it should be. */
+   verify that the result is what it should be.
+
+   parallel_merge_threads() sorts the chunks in place in threads
+   of this process instead, without the files and child
+   processes. */
 
 #include "tests/vm/parallel-merge.h"
 #include <stdio.h>
@@ -82,6 +86,43 @@ sort_chunks (const char *subprocess, int exit_status)
     }
 }
 
+/* Sorts the chunk of buf1 at CHUNK in place, using counting sort
+   as child-sort does, and returns the same status. */
+static int
+sort_chunk (void *chunk)
+{
+  unsigned char *buf = chunk;
+  size_t counts[256] = { 0 };
+  size_t i;
+
+  for (i = 0; i < CHUNK_SIZE; i++)
+    counts[buf[i]]++;
+  for (i = 0; i < sizeof counts / sizeof *counts; i++)
+    while (counts[i]-- > 0)
+      *buf++ = i;
+  return 123;
+}
+
+/* Sort each chunk of buf1 in place in a thread of its own. */
+static void
+sort_chunks_threads (void)
+{
+  tid_t threads[CHUNK_CNT];
+  size_t i;
+
+  for (i = 0; i < CHUNK_CNT; i++)
+    {
+      msg ("sort chunk %zu", i);
+      quiet = true;
+      CHECK ((threads[i] = thread_create (sort_chunk, buf1 + CHUNK_SIZE * i))
+             != TID_ERROR, "thread_create");
+      quiet = false;
+    }
+
+  for (i = 0; i < CHUNK_CNT; i++)
+    CHECK (thread_join (threads[i]) == 123, "join thread %zu", i);
+}
+
 /* Merge the sorted chunks in buf1 into a fully sorted buf2. */
 static void
 merge (void)
@@ -149,3 +190,12 @@ parallel_merge (const char *child_name, int exit_status)
   merge ();
   verify ();
 }
+
+void
+parallel_merge_threads (void)
+{
+  init ();
+  sort_chunks_threads ();
+  merge ();
+  verify ();
+}
@@ -0,0 +1,262 @@
+#include "threads/alloctrack.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/spinlock.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Allocation tracker.
+
+   Built in only with ALLOC_TRACK defined (make ALLOC_TRACK=1)
+   and switched on with the -alloctrack kernel option.  malloc()
+   and palloc record the address each allocation was made from
+   (the "call site"), and every call site keeps its live bytes
+   and blocks, its peak live bytes, and its allocation and free
+   counts.  A site whose live bytes only ever grow is leaking.
+
+   Two open-addressed hash tables with linear probing hold the
+   data: one maps each live block to its size and call site, the
+   other maps call sites to their counters.  malloc() gets the
+   pages for its arenas with PAL_NOTRACK, so that they are counted
+   only as the blocks in them.  Both are allocated
+   from the page allocator once, at boot, so tracking never
+   allocates.  When either fills up, further allocations are
+   counted as untracked instead.
+
+   The report lists the top ALLOC_TRACK_TOP sites by live bytes
+   and the addresses to feed to the `backtrace' utility.  It is
+   printed at power off and whenever the kernel or a user program
+   raises interrupt 0x45. */
+
+#ifdef ALLOC_TRACK
+#define LIVE_BITS 16                    /* log2 of live table size. */
+#define LIVE_CNT (1 << LIVE_BITS)
+#define SITE_BITS 10                    /* log2 of site table size. */
+#define SITE_CNT (1 << SITE_BITS)
+#define ALLOC_TRACK_TOP 20              /* Sites in the report. */
+
+/* A live block. */
+struct live {
+	const void *ptr;                    /* Block, or null if slot empty. */
+	uint32_t size;                      /* Size in bytes. */
+	uint16_t site;                      /* Index in sites. */
+};
+
+/* A call site. */
+struct site {
+	const void *caller;                 /* Return address, or null. */
+	enum alloc_kind kind;               /* Allocator called. */
+	size_t live_bytes;                  /* Bytes allocated, not freed. */
+	size_t live_blocks;                 /* Blocks allocated, not freed. */
+	size_t peak_bytes;                  /* Most live_bytes ever. */
+	uint64_t allocs;                    /* Allocations. */
+	uint64_t frees;                     /* Frees. */
+};
+
+bool alloc_track;
+
+static struct live *lives;              /* LIVE_CNT entries. */
+static struct site *sites;              /* SITE_CNT entries. */
+static size_t live_cnt, site_cnt;
+static uint64_t untracked;              /* Allocations that did not fit. */
+static struct spinlock track_lock;
+
+/* Copy of the top sites, printed after track_lock is released,
+   since printf() may sleep.  Protected by report_lock. */
+static struct site report[ALLOC_TRACK_TOP];
+static struct lock report_lock;
+
+static void inspect_allocs (struct intr_frame *);
+
+/* Returns a hash of pointer P in [0, 1 << BITS). */
+static inline size_t
+hash_ptr (const void *p, int bits) {
+	return ((uint64_t) p * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+}
+
+/* Allocates the tables and registers the inspect interrupt, if
+   the tracker was switched on. */
+void
+alloc_track_init (void) {
+	struct live *l;
+	struct site *s;
+
+	if (!alloc_track)
+		return;
+	spinlock_init (&track_lock, "alloc track");
+	lock_init (&report_lock);
+	l = palloc_get_multiple (PAL_ZERO,
+			DIV_ROUND_UP (LIVE_CNT * sizeof *lives, PGSIZE));
+	s = palloc_get_multiple (PAL_ZERO,
+			DIV_ROUND_UP (SITE_CNT * sizeof *sites, PGSIZE));
+	if (l == NULL || s == NULL)
+		PANIC ("alloc_track_init: out of memory");
+	sites = s;
+	lives = l;
+	intr_register_int (0x45, 3, INTR_OFF, inspect_allocs,
+			"Inspect Allocations");
+}
+
+/* Returns the index of CALLER's entry in sites, creating it if
+   necessary, or SITE_CNT if the table is full. */
+static size_t
+site_get (enum alloc_kind kind, const void *caller) {
+	size_t i = hash_ptr (caller, SITE_BITS);
+
+	while (sites[i].caller != NULL) {
+		if (sites[i].caller == caller)
+			return i;
+		i = (i + 1) & (SITE_CNT - 1);
+	}
+	if (site_cnt >= SITE_CNT * 3 / 4)
+		return SITE_CNT;
+	site_cnt++;
+	sites[i].caller = caller;
+	sites[i].kind = kind;
+	return i;
+}
+
+/* Records that CALLER obtained the SIZE-byte block PTR from the
+   allocator KIND. */
+void
+alloc_track_alloc (enum alloc_kind kind, const void *caller,
+		const void *ptr, size_t size) {
+	enum intr_level old_level;
+	struct site *s;
+	size_t site, i;
+
+	if (lives == NULL || ptr == NULL)
+		return;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&track_lock);
+	site = site_get (kind, caller);
+	if (site == SITE_CNT || live_cnt >= LIVE_CNT * 3 / 4) {
+		untracked++;
+		goto done;
+	}
+
+	for (i = hash_ptr (ptr, LIVE_BITS); lives[i].ptr != NULL;
+			i = (i + 1) & (LIVE_CNT - 1))
+		continue;
+	lives[i].ptr = ptr;
+	lives[i].size = size;
+	lives[i].site = site;
+	live_cnt++;
+
+	s = &sites[site];
+	s->allocs++;
+	s->live_blocks++;
+	s->live_bytes += size;
+	if (s->live_bytes > s->peak_bytes)
+		s->peak_bytes = s->live_bytes;
+done:
+	spinlock_release (&track_lock);
+	intr_set_level (old_level);
+}
+
+/* Records that block PTR was freed.  Does nothing if PTR was not
+   tracked. */
+void
+alloc_track_free (const void *ptr) {
+	enum intr_level old_level;
+	size_t i, j;
+
+	if (lives == NULL || ptr == NULL)
+		return;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&track_lock);
+	for (i = hash_ptr (ptr, LIVE_BITS); lives[i].ptr != ptr;
+			i = (i + 1) & (LIVE_CNT - 1))
+		if (lives[i].ptr == NULL)
+			goto done;
+
+	sites[lives[i].site].frees++;
+	sites[lives[i].site].live_blocks--;
+	sites[lives[i].site].live_bytes -= lives[i].size;
+	live_cnt--;
+
+	/* Close the gap: move back every later entry of the run whose
+	   home slot is not cyclically within (I, J]. */
+	for (j = (i + 1) & (LIVE_CNT - 1); lives[j].ptr != NULL;
+			j = (j + 1) & (LIVE_CNT - 1)) {
+		size_t home = hash_ptr (lives[j].ptr, LIVE_BITS);
+
+		if (((j - home) & (LIVE_CNT - 1)) >= ((j - i) & (LIVE_CNT - 1))) {
+			lives[i] = lives[j];
+			i = j;
+		}
+	}
+	lives[i].ptr = NULL;
+done:
+	spinlock_release (&track_lock);
+	intr_set_level (old_level);
+}
+
+/* Prints the report when a program raises interrupt 0x45. */
+static void
+inspect_allocs (struct intr_frame *f UNUSED) {
+	alloc_track_print ();
+}
+#endif /* ALLOC_TRACK */
+
+/* Prints the top call sites by live bytes, if the tracker is on. */
+void
+alloc_track_print (void) {
+#ifdef ALLOC_TRACK
+	static const char *kinds[] = {"malloc", "palloc"};
+	struct site *top[ALLOC_TRACK_TOP];
+	enum intr_level old_level;
+	size_t cnt = 0, blocks, site_total, i, j;
+	uint64_t lost;
+
+	if (lives == NULL)
+		return;
+
+	/* Insertion sort by live bytes, largest first, and copy the
+	   result out. */
+	lock_acquire (&report_lock);
+	old_level = intr_disable ();
+	spinlock_acquire (&track_lock);
+	for (i = 0; i < SITE_CNT; i++) {
+		struct site *s = &sites[i];
+
+		if (s->caller == NULL
+				|| (cnt == ALLOC_TRACK_TOP
+					&& top[cnt - 1]->live_bytes >= s->live_bytes))
+			continue;
+		if (cnt < ALLOC_TRACK_TOP)
+			cnt++;
+		for (j = cnt - 1; j > 0 && top[j - 1]->live_bytes < s->live_bytes; j--)
+			top[j] = top[j - 1];
+		top[j] = s;
+	}
+	for (i = 0; i < cnt; i++)
+		report[i] = *top[i];
+	blocks = live_cnt;
+	site_total = site_cnt;
+	lost = untracked;
+	spinlock_release (&track_lock);
+	intr_set_level (old_level);
+
+	printf ("Allocations: %zu live blocks from %zu call sites, "
+			"%llu untracked\n", blocks, site_total, lost);
+	for (i = 0; i < cnt; i++)
+		printf ("  %p %s: %zu bytes live in %zu blocks, peak %zu, "
+				"%llu allocs, %llu frees\n", report[i].caller,
+				kinds[report[i].kind], report[i].live_bytes,
+				report[i].live_blocks, report[i].peak_bytes, report[i].allocs,
+				report[i].frees);
+	printf ("Call sites:");
+	for (i = 0; i < cnt; i++)
+		printf (" %p", report[i].caller);
+	printf (".\n");
+	lock_release (&report_lock);
+#endif
+}
@@ -0,0 +1,198 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Lazy x87/SSE context switching.
+
+   The kernel itself is built without floating point, so only
+   user programs touch the FPU.  Rather than saving and restoring
+   512 bytes of FPU state on every thread switch, the FPU
+   registers are left alone and CR0.TS is set whenever a thread
+   other than the one whose state they hold (the "owner") is
+   switched in.  The first FPU instruction such a thread executes
+   raises #NM (Device Not Available), whose handler saves the
+   owner's state, loads the current thread's, and makes it the
+   owner.  Threads that never use the FPU never take the trap and
+   never get a save area.
+
+   See [IA32-v3a] 13.4 "Designing OS Facilities for Saving x87
+   FPU, SSE and Extended States on Task or Context Switches". */
+
+#define CR0_MP 0x00000002       /* Monitor coprocessor. */
+#define CR0_EM 0x00000004       /* Emulation. */
+#define CR0_TS 0x00000008       /* Task switched. */
+#define CR0_NE 0x00000020       /* Native x87 error reporting. */
+#define CR4_OSFXSR 0x00000200   /* FXSAVE/FXRSTOR and SSE enabled. */
+#define CR4_OSXMMEXCPT 0x00000400 /* #XF for unmasked SSE exceptions. */
+
+/* Size and required alignment of an FXSAVE area. */
+#define FPU_AREA_SIZE 512
+#define FPU_AREA_ALIGN 16
+
+/* Thread whose state is in the FPU registers, or a null pointer
+   if they hold nothing worth saving. */
+static struct thread *fpu_owner;
+
+/* Whether CR0.TS is set.  Cached because writing CR0 is slow and
+   serializing, and most switches need not change it. */
+static bool ts_set;
+
+/* Statistics. */
+static long long trap_cnt;      /* # of #NM traps handled. */
+static long long save_cnt;      /* # of FPU states saved. */
+static long long ts_writes;     /* # of CR0.TS changes on switches. */
+static uint64_t trap_cycles;    /* TSC cycles spent handling #NM. */
+
+static intr_handler_func fpu_trap;
+
+/* Pristine FPU state, captured just after FNINIT.  Loaded into a
+   thread the first time it uses the FPU. */
+static uint8_t fpu_initial[FPU_AREA_SIZE] __attribute__ ((aligned (FPU_AREA_ALIGN)));
+
+/* Enables the FPU and SSE, with CR0.TS set so that the first use
+   traps, and registers the #NM handler. */
+void
+fpu_init (void) {
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT);
+	lcr0 ((rcr0 () & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+	asm volatile ("fninit");
+	fxsave (fpu_initial);
+
+	lcr0 (rcr0 () | CR0_TS);
+	ts_set = true;
+
+	intr_register_int (7, 0, INTR_ON, fpu_trap,
+			"#NM Device Not Available Exception");
+}
+
+/* Sets CR0.TS if NEXT, which is about to be switched in, does not
+   own the FPU registers, and clears it if it does.  Interrupts
+   must be off. */
+void
+fpu_switch (struct thread *next) {
+	bool want_ts = next != fpu_owner;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (want_ts != ts_set) {
+		if (want_ts)
+			lcr0 (rcr0 () | CR0_TS);
+		else
+			clts ();
+		ts_set = want_ts;
+		ts_writes++;
+	}
+}
+
+/* Allocates T's FPU save area, if it does not have one yet.
+   Returns false if memory is exhausted. */
+static bool
+alloc_area (struct thread *t) {
+	uint8_t *raw;
+
+	if (t->fpu != NULL)
+		return true;
+
+	raw = malloc (FPU_AREA_SIZE + FPU_AREA_ALIGN - 1);
+	if (raw == NULL)
+		return false;
+	t->fpu_alloc = raw;
+	t->fpu = (uint8_t *) (((uintptr_t) raw + FPU_AREA_ALIGN - 1)
+			& ~(uintptr_t) (FPU_AREA_ALIGN - 1));
+	memcpy (t->fpu, fpu_initial, FPU_AREA_SIZE);
+	return true;
+}
+
+/* Writes the owner's state back to its save area.  The registers
+   keep holding it.  Interrupts must be off and CR0.TS clear. */
+static void
+save_owner (void) {
+	if (fpu_owner != NULL) {
+		fxsave (fpu_owner->fpu);
+		save_cnt++;
+	}
+}
+
+/* #NM handler: gives the FPU to the running thread. */
+static void
+fpu_trap (struct intr_frame *f) {
+	struct thread *curr = thread_current ();
+	uint64_t start = rdtsc ();
+	enum intr_level old_level;
+
+	/* The kernel never uses the FPU. */
+	if ((f->cs & 3) == 0)
+		PANIC ("FPU used in kernel mode at %p", (void *) f->rip);
+
+	/* Allocating may sleep, so do it before taking over the FPU. */
+	if (!alloc_area (curr)) {
+		printf ("%s: out of memory for FPU state\n", thread_name ());
+		thread_exit ();
+	}
+
+	old_level = intr_disable ();
+	clts ();
+	ts_set = false;
+	if (fpu_owner != curr) {
+		save_owner ();
+		fxrstor (curr->fpu);
+		fpu_owner = curr;
+	}
+	trap_cnt++;
+	trap_cycles += rdtsc () - start;
+	intr_set_level (old_level);
+}
+
+/* Gives CHILD a copy of PARENT's FPU state, for fork().  Returns
+   false if memory is exhausted. */
+bool
+fpu_fork (struct thread *child, struct thread *parent) {
+	enum intr_level old_level;
+
+	if (parent->fpu == NULL)
+		return true;
+	if (!alloc_area (child))
+		return false;
+
+	old_level = intr_disable ();
+	if (fpu_owner == parent) {
+		clts ();
+		ts_set = false;
+		save_owner ();
+		fpu_switch (thread_current ());
+	}
+	memcpy (child->fpu, parent->fpu, FPU_AREA_SIZE);
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Discards T's FPU state, for exec() and thread exit. */
+void
+fpu_release (struct thread *t) {
+	enum intr_level old_level = intr_disable ();
+
+	if (fpu_owner == t) {
+		fpu_owner = NULL;
+		fpu_switch (thread_current ());
+	}
+	intr_set_level (old_level);
+
+	free (t->fpu_alloc);
+	t->fpu_alloc = t->fpu = NULL;
+}
+
+/* Prints FPU statistics. */
+void
+fpu_print_stats (void) {
+	printf ("FPU: %lld lazy restores, %lld saves, %lld TS changes, "
+			"%"PRIu64" cycles per restore\n",
+			trap_cnt, save_cnt, ts_writes,
+			trap_cnt > 0 ? trap_cycles / trap_cnt : 0);
+}
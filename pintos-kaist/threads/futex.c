@@ -0,0 +1,180 @@
+#include "threads/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Fast user-space mutexes ("futexes").
+
+   A futex is just an int.  Threads that want to sleep until the
+   int changes call futex_wait(), and whoever changes it calls
+   futex_wake().  The int itself is only ever touched by the
+   caller, so the common case of taking or dropping an
+   uncontended user lock never has to enter the kernel.
+
+   Each address that has sleepers gets a wait queue in
+   futex_table, created on the first futex_wait() and freed when
+   its last sleeper leaves.  Queues are keyed by kernel virtual
+   address.  For user memory, the system call layer passes the
+   address of the word within the kernel's mapping of the user
+   frame, which is unique to the physical frame, so two processes
+   that map the same frame share one queue no matter where each
+   of them maps it.
+
+   Sleepers wait on a condition variable, so they are woken in
+   priority order and take part in priority donation like any
+   other kernel waiter.  A sleeper may also pass a cancel flag,
+   which lets futex_cancel() wake it without touching the futex,
+   as when its process is killed. */
+
+/* Wait queue for one futex address. */
+struct futex_queue {
+	struct hash_elem elem;      /* Element in futex_table. */
+	const int *addr;            /* Key: kernel address of the futex. */
+	struct condition cond;      /* Sleeping threads. */
+	struct list sleepers;       /* Sleepers, including ones just woken. */
+};
+
+/* A thread in futex_wait(), on its stack. */
+struct futex_sleeper {
+	struct list_elem elem;      /* Element in futex_queue's sleepers. */
+	const bool *cancel;         /* Cancel flag, or a null pointer. */
+};
+
+/* Maps futex addresses to wait queues. */
+static struct hash futex_table;
+
+/* Protects futex_table and every futex_queue in it.  Also makes
+   futex_wait()'s check of the futex value atomic with respect to
+   futex_wake(), so no wakeup can be lost between the two. */
+static struct lock futex_lock;
+
+static hash_hash_func futex_hash;
+static hash_less_func futex_less;
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void) {
+	hash_init (&futex_table, futex_hash, futex_less, NULL);
+	lock_init (&futex_lock);
+}
+
+/* Returns the wait queue for ADDR, or a null pointer if no thread
+   is waiting on ADDR. */
+static struct futex_queue *
+lookup (const int *addr) {
+	struct futex_queue key;
+	struct hash_elem *e;
+
+	key.addr = addr;
+	e = hash_find (&futex_table, &key.elem);
+	return e != NULL ? hash_entry (e, struct futex_queue, elem) : NULL;
+}
+
+/* If *ADDR equals VAL, sleeps until woken by futex_wake() on
+   ADDR and returns true.  Otherwise returns false at once.  As
+   with condition variables, a true return only means that the
+   futex may have changed; the caller must recheck it.
+
+   If CANCEL is nonnull, also returns false at once if *CANCEL is
+   true, and futex_cancel(CANCEL) wakes the sleeper, which then
+   returns true like any other wakeup. */
+bool
+futex_wait (const int *addr, int val, const bool *cancel) {
+	struct futex_queue *q;
+	struct futex_sleeper s;
+
+	ASSERT (addr != NULL);
+
+	lock_acquire (&futex_lock);
+	if (*addr != val || (cancel != NULL && *cancel)) {
+		lock_release (&futex_lock);
+		return false;
+	}
+
+	q = lookup (addr);
+	if (q == NULL) {
+		q = malloc (sizeof *q);
+		if (q == NULL) {
+			lock_release (&futex_lock);
+			return false;
+		}
+		q->addr = addr;
+		cond_init (&q->cond);
+		list_init (&q->sleepers);
+		hash_insert (&futex_table, &q->elem);
+	}
+
+	s.cancel = cancel;
+	list_push_back (&q->sleepers, &s.elem);
+	cond_wait (&q->cond, &futex_lock);
+	list_remove (&s.elem);
+	if (list_empty (&q->sleepers)) {
+		hash_delete (&futex_table, &q->elem);
+		free (q);
+	}
+	lock_release (&futex_lock);
+	return true;
+}
+
+/* Wakes up to CNT threads sleeping on ADDR, highest priority
+   first, and returns the number woken. */
+int
+futex_wake (const int *addr, int cnt) {
+	struct futex_queue *q;
+	int woken = 0;
+
+	ASSERT (addr != NULL);
+
+	lock_acquire (&futex_lock);
+	q = lookup (addr);
+	if (q != NULL)
+		while (woken < cnt && !pq_empty (&q->cond.waiters)) {
+			cond_signal (&q->cond, &futex_lock);
+			woken++;
+		}
+	lock_release (&futex_lock);
+	return woken;
+}
+
+/* Wakes every thread sleeping in futex_wait() with CANCEL as its
+   cancel flag, which the caller has set beforehand.  Threads
+   sharing a futex with one of them may wake spuriously. */
+void
+futex_cancel (const bool *cancel) {
+	struct hash_iterator i;
+
+	ASSERT (cancel != NULL);
+
+	lock_acquire (&futex_lock);
+	hash_first (&i, &futex_table);
+	while (hash_next (&i)) {
+		struct futex_queue *q = hash_entry (hash_cur (&i),
+				struct futex_queue, elem);
+		struct list_elem *e;
+
+		for (e = list_begin (&q->sleepers); e != list_end (&q->sleepers);
+				e = list_next (e))
+			if (list_entry (e, struct futex_sleeper, elem)->cancel == cancel) {
+				cond_broadcast (&q->cond, &futex_lock);
+				break;
+			}
+	}
+	lock_release (&futex_lock);
+}
+
+/* Returns a hash value for futex queue E. */
+static uint64_t
+futex_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct futex_queue *q = hash_entry (e, struct futex_queue, elem);
+	return hash_bytes (&q->addr, sizeof q->addr);
+}
+
+/* Returns true if futex queue A's address precedes B's. */
+static bool
+futex_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct futex_queue *a = hash_entry (a_, struct futex_queue, elem);
+	const struct futex_queue *b = hash_entry (b_, struct futex_queue, elem);
+	return a->addr < b->addr;
+}
@@ -13,18 +13,25 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/alloctrack.h"
+#include "threads/fpu.h"
+#include "threads/futex.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/schedtrace.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/hugepage.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #endif
@@ -86,7 +93,11 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+	slab_init ();
 	paging_init (mem_end);
+	futex_init ();
+	workqueue_init ();
+	sched_trace_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -95,6 +106,8 @@ main (void) {
 
 	/* Initialize interrupt handlers. */
 	intr_init ();
+	alloc_track_init ();
+	fpu_init ();
 	timer_init ();
 	kbd_init ();
 	input_init ();
@@ -104,6 +117,10 @@ main (void) {
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
+	workqueue_start ();
+#ifdef USERPROG
+	hugepage_init ();
+#endif
 	serial_init_queue ();
 	timer_calibrate ();
 
@@ -143,26 +160,46 @@ bss_init (void) {
 
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ *
+ * Memory is mapped with 2 MB large pages, except for the 2 MB
+ * regions that hold read-only kernel text and the partial region
+ * at the end of memory, which get 4 kB pages. */
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
+	size_t large_cnt = 0, small_cnt = 0;
 	int perm;
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (uint64_t pa = 0; pa < mem_end; ) {
 		uint64_t va = (uint64_t) ptov(pa);
 
+		if (large_pg_ofs (pa) == 0 && pa + LARGE_PGSIZE <= mem_end
+				&& (va + LARGE_PGSIZE <= (uint64_t) &start
+					|| va >= (uint64_t) &_end_kernel_text)) {
+			if ((pte = pml4_pde_walk (pml4, va, 1)) == NULL)
+				PANIC ("paging_init: out of memory");
+			*pte = pa | PTE_P | PTE_W | PTE_PS;
+			pa += LARGE_PGSIZE;
+			large_cnt++;
+			continue;
+		}
+
 		perm = PTE_P | PTE_W;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
 			*pte = pa | perm;
+		pa += PGSIZE;
+		small_cnt++;
 	}
+	printf ("Kernel mapping: %zu 2 MB pages, %zu 4 kB pages\n",
+			large_cnt, small_cnt);
 
 	// reload cr3
 	pml4_activate(0);
@@ -222,6 +259,20 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-schedtrace"))
+			sched_trace_enabled = true;
+#ifdef LOCK_PROFILE
+		else if (!strcmp (name, "-lockprof"))
+			lock_profile = true;
+#endif
+		else if (!strcmp (name, "-largepages"))
+			large_user_pages = true;
+#ifdef ALLOC_TRACK
+		else if (!strcmp (name, "-alloctrack"))
+			alloc_track = true;
+#endif
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -327,6 +378,15 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -tickless          Stop the timer tick while the CPU is idle.\n"
+			"  -schedtrace        Trace scheduling latency, dump it at exit.\n"
+#ifdef LOCK_PROFILE
+			"  -lockprof          Print lock contention statistics at exit.\n"
+#endif
+			"  -largepages        Map full 2 MB user regions with large pages.\n"
+#ifdef ALLOC_TRACK
+			"  -alloctrack        Track allocations by call site, report at exit.\n"
+#endif
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -355,6 +415,14 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	malloc_print_stats ();
+	slab_print_stats ();
+	pml4_print_stats ();
+	alloc_track_print ();
+	workqueue_print_stats ();
+	lock_print_stats ();
+	fpu_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -362,5 +430,7 @@ print_stats (void) {
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	hugepage_print_stats ();
 #endif
+	sched_trace_print ();
 }
@@ -8,11 +8,13 @@
 #include "threads/io.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
+#include "threads/workqueue.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #endif
 
 /* Number of x86_64 interrupts. */
@@ -103,6 +105,13 @@ static const char *intr_names[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Once the outermost external interrupt has been acknowledged,
+   deferred work queued by its handler runs with interrupts on but
+   still in interrupt context (see workqueue.c).  An external
+   interrupt that arrives meanwhile is handled as usual, but leaves
+   the deferred work and any yield to the pass it interrupted. */
+static bool in_softirq;         /* Are we running deferred work? */
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -252,11 +261,12 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt,
+   including the deferred work run on its return, and false at all
+   other times. */
 bool
 intr_context (void) {
-	return in_external_intr;
+	return in_external_intr || in_softirq;
 }
 
 /* During processing of an external interrupt, directs the
@@ -340,10 +350,11 @@ intr_handler (struct intr_frame *frame) {
 	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
-		ASSERT (!intr_context ());
+		ASSERT (!in_external_intr);
 
 		in_external_intr = true;
-		yield_on_return = false;
+		if (!in_softirq)
+			yield_on_return = false;
 	}
 
 	/* Invoke the interrupt's handler. */
@@ -364,14 +375,27 @@ intr_handler (struct intr_frame *frame) {
 	/* Complete the processing of an external interrupt. */
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
-		ASSERT (intr_context ());
+		ASSERT (in_external_intr);
 
 		in_external_intr = false;
 		pic_end_of_interrupt (frame->vec_no);
 
+		if (in_softirq)
+			return;
+		if (workqueue_softirq_pending ()) {
+			in_softirq = true;
+			workqueue_softirq ();
+			in_softirq = false;
+		}
 		if (yield_on_return)
 			thread_yield ();
 	}
+
+#ifdef USERPROG
+	/* Another thread of the process may have called exit(). */
+	if (frame->cs == SEL_UCSEG)
+		process_check_killed ();
+#endif
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
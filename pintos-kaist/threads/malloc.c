@@ -5,6 +5,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/alloctrack.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -26,30 +29,97 @@
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
-
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   and give the arena back to the page allocator, unless the
+   descriptor is keeping fewer than ARENA_RESERVE empty arenas,
+   so that a block allocated and freed over and over does not
+   take a page from palloc every time.
+
+   In front of each descriptor's free list, every CPU has a
+   "magazine" of free blocks of that size, which it touches only
+   with interrupts off and so without taking the descriptor's
+   lock.  malloc() takes a block from the magazine if it can and
+   otherwise refills the magazine from the free list with a batch
+   of blocks under a single lock acquisition.  free() likewise
+   puts the block in the magazine, flushing a batch back to the
+   free list when the magazine is full.
+
+   Blocks of 2 kB and up don't fit a one-page arena well, so
+   from 1.5 kB to LARGE_MAX the sizes go up by factors of 1.5
+   and 2 alternately (1.5 kB, 2 kB, 3 kB, 4 kB, 6 kB, ...), and
+   each such descriptor's arenas span just enough contiguous
+   pages to hold LARGE_ARENA_BLOCKS blocks with no space left
+   over.  Their arena headers are malloc()'d separately.  The
+   arena of any block is found through palloc_get_owner(), which
+   every arena sets for its pages.
+
+   We handle blocks bigger than LARGE_MAX by allocating
+   contiguous pages with the page allocator and sticking the
+   allocation size at the beginning of the allocated block's
+   arena header.  The last few of these page runs to be freed
+   are cached, so that a large buffer allocated and freed over
+   and over does not go back to the page allocator every time. */
+
+/* Largest block size with a descriptor. */
+#define LARGE_MAX (4 * PGSIZE)
+
+/* Blocks in an arena of a descriptor for blocks of 1.5 kB or
+   more. */
+#define LARGE_ARENA_BLOCKS 4
+
+/* Freed page runs cached for reuse. */
+#define RUN_CACHE_MAX 8
+
+/* Most blocks moved between a magazine and a free list at once.
+   A magazine holds up to twice as many. */
+#define MAG_BATCH 8
+
+/* Empty arenas each descriptor keeps rather than freeing. */
+#define ARENA_RESERVE 2
+
+/* One CPU's cache of free blocks of one size. */
+struct magazine {
+	void *blocks[2 * MAG_BATCH];    /* Free blocks, most recent last. */
+	size_t cnt;                     /* Number of blocks. */
+};
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
+	size_t arena_pages;         /* Pages in an arena. */
+	size_t batch;               /* Blocks per magazine refill or flush;
+	                               a magazine holds up to twice as many. */
 	struct list free_list;      /* List of free blocks. */
+	size_t empty_cnt;           /* Arenas with no blocks in use. */
 	struct lock lock;           /* Lock. */
+	struct magazine mags[CPU_MAX]; /* Per-CPU magazines. */
+
+	/* Statistics, protected by lock. */
+	long long arena_allocs;     /* Arenas obtained from palloc. */
+	long long arena_frees;      /* Arenas given back to palloc. */
 };
 
+/* Per-CPU statistics, updated with interrupts off. */
+struct malloc_stats {
+	long long allocs;           /* Calls to malloc() that succeeded. */
+	long long frees;            /* Calls to free() with a block. */
+	long long mag_allocs;       /* Allocations from a magazine. */
+	long long mag_frees;        /* Frees into a magazine. */
+	long long big_allocs;       /* Allocations of page runs. */
+	long long run_hits;         /* Those from the run cache. */
+};
+static struct malloc_stats stats[CPU_MAX];
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
-/* Arena. */
+/* Arena.  At the start of a one-page arena or big block, but
+   malloc()'d for the arena of a multi-page descriptor. */
 struct arena {
 	unsigned magic;             /* Always set to ARENA_MAGIC. */
 	struct desc *desc;          /* Owning descriptor, null for big block. */
 	size_t free_cnt;            /* Free blocks; pages in big block. */
+	uint8_t *blocks;            /* First block. */
 };
 
 /* Free block. */
@@ -58,34 +128,105 @@ struct block {
 };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[16];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Recently freed big blocks, most recent last. */
+static struct arena *run_cache[RUN_CACHE_MAX];
+static size_t run_cnt;
+static struct lock run_lock;
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *get_block (size_t size);
+static void *refill (struct desc *);
+static void flush (struct desc *, void *blocks[], size_t cnt);
+static size_t run_cache_reclaim (void);
+
+/* Adds a descriptor for BLOCK_SIZE-byte blocks. */
+static void
+add_desc (size_t block_size) {
+	struct desc *d = &descs[desc_cnt++];
+
+	ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+	d->block_size = block_size;
+	if (block_size < PGSIZE / 2) {
+		d->arena_pages = 1;
+		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+	} else {
+		d->arena_pages = 1;
+		while (d->arena_pages * PGSIZE % block_size != 0
+				|| d->arena_pages * PGSIZE / block_size < LARGE_ARENA_BLOCKS)
+			d->arena_pages++;
+		d->blocks_per_arena = d->arena_pages * PGSIZE / block_size;
+	}
+	d->batch = d->blocks_per_arena < MAG_BATCH ? d->blocks_per_arena
+		: MAG_BATCH;
+	list_init (&d->free_list);
+	lock_init (&d->lock);
+}
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
 	size_t block_size;
 
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
-		lock_init (&d->lock);
+	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+		add_desc (block_size);
+	for (block_size = PGSIZE / 4; block_size < LARGE_MAX; block_size *= 2) {
+		add_desc (block_size * 3 / 2);
+		add_desc (block_size * 2);
 	}
+	lock_init (&run_lock);
+	palloc_register_reclaim (run_cache_reclaim);
+}
+
+/* Prints malloc() statistics. */
+void
+malloc_print_stats (void) {
+	struct malloc_stats total = { 0 };
+	long long arena_allocs = 0, arena_frees = 0;
+	unsigned id;
+	struct desc *d;
+
+	for (id = 0; id < cpu_cnt; id++) {
+		total.allocs += stats[id].allocs;
+		total.frees += stats[id].frees;
+		total.mag_allocs += stats[id].mag_allocs;
+		total.mag_frees += stats[id].mag_frees;
+		total.big_allocs += stats[id].big_allocs;
+		total.run_hits += stats[id].run_hits;
+	}
+	for (d = descs; d < descs + desc_cnt; d++) {
+		arena_allocs += d->arena_allocs;
+		arena_frees += d->arena_frees;
+	}
+	printf ("Malloc: %lld allocations (%lld from magazines, %lld of pages, "
+			"%lld of those cached), %lld frees (%lld into magazines), "
+			"%lld arenas allocated, %lld freed\n", total.allocs,
+			total.mag_allocs, total.big_allocs, total.run_hits, total.frees,
+			total.mag_frees, arena_allocs, arena_frees);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
+	void *p = get_block (size);
+
+	ALLOC_TRACK_DO (alloc_track_alloc (ALLOC_MALLOC,
+				__builtin_return_address (0), p, size));
+	return p;
+}
+
+/* Does the work of malloc(). */
+static void *
+get_block (size_t size) {
 	struct desc *d;
-	struct block *b;
+	struct magazine *m;
 	struct arena *a;
+	enum intr_level old_level;
+	void *b;
 
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
@@ -98,31 +239,97 @@ malloc (size_t size) {
 			break;
 	if (d == descs + desc_cnt) {
 		/* SIZE is too big for any descriptor.
-		   Allocate enough pages to hold SIZE plus an arena. */
+		   Allocate enough pages to hold SIZE plus an arena, reusing
+		   a recently freed run of that many if there is one. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-		a = palloc_get_multiple (0, page_cnt);
-		if (a == NULL)
-			return NULL;
+		bool cached = false;
+		size_t i;
 
-		/* Initialize the arena to indicate a big block of PAGE_CNT
-		   pages, and return it. */
-		a->magic = ARENA_MAGIC;
-		a->desc = NULL;
-		a->free_cnt = page_cnt;
+		a = NULL;
+		lock_acquire (&run_lock);
+		for (i = run_cnt; i-- > 0; )
+			if (run_cache[i]->free_cnt == page_cnt) {
+				a = run_cache[i];
+				run_cache[i] = run_cache[--run_cnt];
+				cached = true;
+				break;
+			}
+		lock_release (&run_lock);
+
+		if (a == NULL) {
+			a = palloc_get_multiple (PAL_NOTRACK, page_cnt);
+			if (a == NULL)
+				return NULL;
+
+			/* Initialize the arena to indicate a big block of PAGE_CNT
+			   pages. */
+			a->magic = ARENA_MAGIC;
+			a->desc = NULL;
+			a->free_cnt = page_cnt;
+			a->blocks = (uint8_t *) (a + 1);
+			palloc_set_owner (a, 1, a);
+		}
+
+		old_level = intr_disable ();
+		stats[this_cpu ()->id].allocs++;
+		stats[this_cpu ()->id].big_allocs++;
+		if (cached)
+			stats[this_cpu ()->id].run_hits++;
+		intr_set_level (old_level);
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
+	/* Take the most recently freed block from this CPU's
+	   magazine, or refill the magazine if it is empty. */
+	old_level = intr_disable ();
+	m = &d->mags[this_cpu ()->id];
+	if (m->cnt > 0) {
+		b = m->blocks[--m->cnt];
+		stats[this_cpu ()->id].mag_allocs++;
+	} else {
+		intr_set_level (old_level);
+		b = refill (d);
+		if (b == NULL)
+			return NULL;
+		old_level = intr_disable ();
+	}
+	stats[this_cpu ()->id].allocs++;
+	intr_set_level (old_level);
+	return b;
+}
+
+/* Takes a block off D's free list, creating a new arena if the
+   list is empty, and returns it, or a null pointer if memory is
+   not available.  D's lock must be held. */
+static struct block *
+take_block (struct desc *d) {
+	struct block *b;
+	struct arena *a;
+
+	ASSERT (lock_held_by_current_thread (&d->lock));
 
 	/* If the free list is empty, create a new arena. */
 	if (list_empty (&d->free_list)) {
 		size_t i;
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
+		/* Allocate a page, or for large blocks, a run of pages and
+		   a separate header. */
+		if (d->arena_pages == 1) {
+			a = palloc_get_page (PAL_NOTRACK);
+			if (a == NULL)
+				return NULL;
+			a->blocks = (uint8_t *) (a + 1);
+			palloc_set_owner (a, 1, a);
+		} else {
+			void *pages = palloc_get_multiple (PAL_NOTRACK, d->arena_pages);
+
+			a = pages != NULL ? malloc (sizeof *a) : NULL;
+			if (a == NULL) {
+				palloc_free_multiple (pages, d->arena_pages);
+				return NULL;
+			}
+			a->blocks = pages;
+			palloc_set_owner (pages, d->arena_pages, a);
 		}
 
 		/* Initialize arena and add its blocks to the free list. */
@@ -133,16 +340,114 @@ malloc (size_t size) {
 			struct block *b = arena_to_block (a, i);
 			list_push_back (&d->free_list, &b->free_elem);
 		}
+		d->empty_cnt++;
+		d->arena_allocs++;
 	}
 
 	/* Get a block from free list and return it. */
 	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
 	a = block_to_arena (b);
-	a->free_cnt--;
-	lock_release (&d->lock);
+	if (a->free_cnt-- == d->blocks_per_arena)
+		d->empty_cnt--;
 	return b;
 }
 
+/* Puts block B back on D's free list.  If that leaves its arena
+   unused, frees the arena, unless D keeps it in reserve.  D's
+   lock must be held. */
+static void
+put_block (struct desc *d, struct block *b) {
+	struct arena *a = block_to_arena (b);
+
+	ASSERT (lock_held_by_current_thread (&d->lock));
+
+	/* Add block to free list. */
+	list_push_front (&d->free_list, &b->free_elem);
+
+	/* If the arena is now entirely unused, free it. */
+	if (++a->free_cnt >= d->blocks_per_arena) {
+		size_t i;
+
+		ASSERT (a->free_cnt == d->blocks_per_arena);
+		if (d->empty_cnt < ARENA_RESERVE) {
+			d->empty_cnt++;
+			return;
+		}
+		for (i = 0; i < d->blocks_per_arena; i++) {
+			struct block *b = arena_to_block (a, i);
+			list_remove (&b->free_elem);
+		}
+		a->magic = 0;
+		if (d->arena_pages == 1)
+			palloc_free_page (a);
+		else {
+			palloc_free_multiple (a->blocks, d->arena_pages);
+			free (a);
+		}
+		d->arena_frees++;
+	}
+}
+
+/* Takes a batch of blocks from D's free list, returns one of them,
+   and puts the rest in this CPU's magazine.  Returns a null
+   pointer if memory is not available. */
+static void *
+refill (struct desc *d) {
+	void *batch[MAG_BATCH];
+	struct magazine *m;
+	enum intr_level old_level;
+	size_t cnt = 0;
+
+	lock_acquire (&d->lock);
+	while (cnt < d->batch && (batch[cnt] = take_block (d)) != NULL)
+		cnt++;
+	lock_release (&d->lock);
+	if (cnt == 0)
+		return NULL;
+
+	/* Blocks freed on this CPU in the meantime may have filled
+	   the magazine; the ones that do not fit go back. */
+	old_level = intr_disable ();
+	m = &d->mags[this_cpu ()->id];
+	while (cnt > 1 && m->cnt < 2 * d->batch)
+		m->blocks[m->cnt++] = batch[--cnt];
+	intr_set_level (old_level);
+	if (cnt > 1)
+		flush (d, batch + 1, cnt - 1);
+	return batch[0];
+}
+
+/* Frees every cached page run and returns the number of pages
+   freed.  Registered with palloc_register_reclaim(). */
+static size_t
+run_cache_reclaim (void) {
+	struct arena *runs[RUN_CACHE_MAX];
+	size_t cnt, freed = 0, i;
+
+	lock_acquire (&run_lock);
+	cnt = run_cnt;
+	memcpy (runs, run_cache, cnt * sizeof *runs);
+	run_cnt = 0;
+	lock_release (&run_lock);
+
+	for (i = 0; i < cnt; i++) {
+		freed += runs[i]->free_cnt;
+		palloc_free_multiple (runs[i], runs[i]->free_cnt);
+	}
+	return freed;
+}
+
+/* Puts the CNT blocks in BLOCKS back on D's free list. */
+static void
+flush (struct desc *d, void *blocks[], size_t cnt) {
+	size_t i;
+
+	lock_acquire (&d->lock);
+	for (i = 0; i < cnt; i++)
+		put_block (d, blocks[i]);
+	lock_release (&d->lock);
+}
+
 /* Allocates and return A times B bytes initialized to zeroes.
    Returns a null pointer if memory is not available. */
 void *
@@ -156,9 +461,11 @@ calloc (size_t a, size_t b) {
 		return NULL;
 
 	/* Allocate and zero memory. */
-	p = malloc (size);
+	p = get_block (size);
 	if (p != NULL)
 		memset (p, 0, size);
+	ALLOC_TRACK_DO (alloc_track_alloc (ALLOC_MALLOC,
+				__builtin_return_address (0), p, size));
 
 	return p;
 }
@@ -185,7 +492,9 @@ realloc (void *old_block, size_t new_size) {
 		free (old_block);
 		return NULL;
 	} else {
-		void *new_block = malloc (new_size);
+		void *new_block = get_block (new_size);
+		ALLOC_TRACK_DO (alloc_track_alloc (ALLOC_MALLOC,
+					__builtin_return_address (0), new_block, new_size));
 		if (old_block != NULL && new_block != NULL) {
 			size_t old_size = block_size (old_block);
 			size_t min_size = new_size < old_size ? new_size : old_size;
@@ -200,6 +509,7 @@ realloc (void *old_block, size_t new_size) {
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) {
+	ALLOC_TRACK_DO (alloc_track_free (p));
 	if (p != NULL) {
 		struct block *b = p;
 		struct arena *a = block_to_arena (b);
@@ -208,32 +518,57 @@ free (void *p) {
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
 
+			void *batch[MAG_BATCH];
+			struct magazine *m;
+			enum intr_level old_level;
+			size_t cnt = 0;
+
 #ifndef NDEBUG
 			/* Clear the block to help detect use-after-free bugs. */
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
+			/* Put the block in this CPU's magazine, first moving the
+			   oldest batch out of it if it is full. */
+			old_level = intr_disable ();
+			m = &d->mags[this_cpu ()->id];
+			if (m->cnt == 2 * d->batch) {
+				cnt = d->batch;
+				memcpy (batch, m->blocks, cnt * sizeof *batch);
+				memmove (m->blocks, m->blocks + cnt,
+						(m->cnt - cnt) * sizeof *m->blocks);
+				m->cnt -= cnt;
+			} else
+				stats[this_cpu ()->id].mag_frees++;
+			m->blocks[m->cnt++] = b;
+			stats[this_cpu ()->id].frees++;
+			intr_set_level (old_level);
+
+			if (cnt > 0)
+				flush (d, batch, cnt);
+		} else {
+			/* It's a big block.  Cache its pages, and free the pages
+			   of the run that has been cached longest if that makes
+			   too many. */
+			enum intr_level old_level = intr_disable ();
+			struct arena *old = NULL;
 
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
+			stats[this_cpu ()->id].frees++;
+			intr_set_level (old_level);
 
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+#ifndef NDEBUG
+			memset (b, 0xcc, PGSIZE * a->free_cnt - sizeof *a);
+#endif
+			lock_acquire (&run_lock);
+			if (run_cnt == RUN_CACHE_MAX) {
+				old = run_cache[0];
+				memmove (run_cache, run_cache + 1,
+						--run_cnt * sizeof *run_cache);
 			}
-
-			lock_release (&d->lock);
-		} else {
-			/* It's a big block.  Free its pages. */
-			palloc_free_multiple (a, a->free_cnt);
+			run_cache[run_cnt++] = a;
+			lock_release (&run_lock);
+			if (old != NULL)
+				palloc_free_multiple (old, old->free_cnt);
 			return;
 		}
 	}
@@ -242,7 +577,7 @@ free (void *p) {
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
-	struct arena *a = pg_round_down (b);
+	struct arena *a = palloc_get_owner (b);
 
 	/* Check that the arena is valid. */
 	ASSERT (a != NULL);
@@ -250,8 +585,8 @@ block_to_arena (struct block *b) {
 
 	/* Check that the block is properly aligned for the arena. */
 	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
-	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
+			|| ((uint8_t *) b - a->blocks) % a->desc->block_size == 0);
+	ASSERT (a->desc != NULL || (uint8_t *) b == a->blocks);
 
 	return a;
 }
@@ -262,7 +597,5 @@ arena_to_block (struct arena *a, size_t idx) {
 	ASSERT (a != NULL);
 	ASSERT (a->magic == ARENA_MAGIC);
 	ASSERT (idx < a->desc->blocks_per_arena);
-	return (struct block *) ((uint8_t *) a
-			+ sizeof *a
-			+ idx * a->desc->block_size);
+	return (struct block *) (a->blocks + idx * a->desc->block_size);
 }
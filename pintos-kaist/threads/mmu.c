@@ -1,13 +1,71 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Large pages.
+
+   The kernel maps physical memory with 2 MB pages wherever it
+   can (see paging_init()), and with -largepages a user 2 MB
+   region whose 512 pages are mapped alike to 512 contiguous,
+   aligned frames is "promoted" to one 2 MB mapping too.  Either
+   way the page directory entry, with PTE_PS set, maps the whole
+   region, and one TLB entry covers it.
+
+   To the functions below such an entry stands for each of the
+   512 pages in its region: pml4e_walk() returns it when CREATE
+   is false, so that its present, writable, user, accessed and
+   dirty bits can be read and changed, with the last two applying
+   to all 512 pages at once.  Anything that maps, unmaps or
+   remaps a single page, by calling pml4e_walk() with CREATE
+   true, first splits the large page back into a page table of
+   512 ordinary entries.  pml4_for_each() splits one only if its
+   callback changes the entry of one of its pages, so that fork()
+   leaves the parent's large pages alone.  Promotion keeps the page table it
+   replaces, as the owner of the region's first frame (see
+   palloc_set_owner()), so that splitting a user large page never
+   needs memory; Linux calls this depositing the page table. */
+
+bool large_user_pages;
+
+static size_t large_maps;               /* User large pages made. */
+static size_t large_splits;             /* User large pages split. */
+
+/* Replaces the large page that PDE maps, at virtual address VA,
+   by a page table that maps the same frames with the same
+   permissions.  Returns false if memory for the page table runs
+   out, which cannot happen for user large pages. */
+static bool
+split_large (uint64_t *pde, uint64_t va) {
+	uint64_t pa = LARGE_PTE_ADDR (*pde);
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+	uint64_t *pt = NULL;
+	size_t i;
+
+	if (is_user_pte (pde)) {
+		pt = palloc_get_owner (ptov (pa));
+		ASSERT (pt != NULL);
+		palloc_set_owner (ptov (pa), 1, NULL);
+		large_splits++;
+	} else {
+		pt = palloc_get_page (0);
+		if (pt == NULL)
+			return false;
+	}
+	for (i = 0; i < LARGE_PGCNT; i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	invlpg (va);
+	return true;
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
@@ -22,6 +80,11 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 					return NULL;
 			} else
 				return NULL;
+		} else if ((uint64_t) pte & PTE_PS) {
+			if (!create)
+				return &pdp[idx];
+			if (!split_large (&pdp[idx], va))
+				return NULL;
 		}
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
@@ -88,6 +151,39 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the table that ENTRY points to, first pointing ENTRY to
+ * a new, empty one if it is not present and CREATE is true.
+ * Returns a null pointer if it is not present and CREATE is
+ * false, or if memory runs out. */
+static uint64_t *
+next_table (uint64_t *entry, int create) {
+	if (!(*entry & PTE_P)) {
+		uint64_t *new_page;
+
+		if (!create || (new_page = palloc_get_page (PAL_ZERO)) == NULL)
+			return NULL;
+		*entry = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+	}
+	return ptov (PTE_ADDR (*entry));
+}
+
+/* Returns the address of the page directory entry for virtual
+ * address VA in PML4, which either maps VA's 2 MB large page or
+ * points to the page table for VA.  If the page directory does
+ * not exist, behavior depends on CREATE as for pml4e_walk(). */
+uint64_t *
+pml4_pde_walk (uint64_t *pml4, const uint64_t va, int create) {
+	uint64_t *pdpe, *pd;
+
+	pdpe = next_table (&pml4[PML4 (va)], create);
+	if (pdpe == NULL)
+		return NULL;
+	pd = next_table (&pdpe[PDPE (va)], create);
+	if (pd == NULL)
+		return NULL;
+	return &pd[PDX (va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -117,10 +213,59 @@ pt_for_each (uint64_t *pt, pte_for_each_func *func, void *aux,
 	return true;
 }
 
+/* Applies FUNC to each page of the user large page that PDE
+ * maps, at virtual address VA, as pt_for_each() does for a page
+ * table.  FUNC gets a copy of the entry that the page would have
+ * if the large page were split.  The large page is only split if
+ * FUNC changes that copy, which then goes into the page table,
+ * and FUNC sees the real entries of the rest of the region. */
+static bool
+large_for_each (uint64_t *pde, uint64_t va, pte_for_each_func *func,
+		void *aux) {
+	uint64_t pa = LARGE_PTE_ADDR (*pde);
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+	uint64_t *pt = NULL;
+
+	for (unsigned i = 0; i < LARGE_PGCNT; i++) {
+		uint64_t page_va = va + i * PGSIZE;
+		uint64_t old = (pa + i * PGSIZE) | flags;
+		uint64_t pte = old;
+		bool ok;
+
+		if (pt != NULL)
+			ok = func (&pt[i], (void *) page_va, aux);
+		else {
+			ok = func (&pte, (void *) page_va, aux);
+			if (pte != old) {
+				split_large (pde, va);
+				pt = ptov (PTE_ADDR (*pde));
+				pt[i] = pte;
+				invlpg (page_va);
+			}
+		}
+		if (!ok)
+			return false;
+	}
+	return true;
+}
+
 static bool
 pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
+		/* Skip the kernel's large pages.  FUNC sees the user's one
+		   page at a time, without splitting them unless it has
+		   to. */
+		if ((pdp[i] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)) {
+			uint64_t va = ((uint64_t) pml4_index << PML4SHIFT) |
+						  ((uint64_t) pdp_index << PDPESHIFT) |
+						  ((uint64_t) i << PDXSHIFT);
+
+			if ((pdp[i] & PTE_U) && !large_for_each (&pdp[i], va, func, aux))
+				return false;
+			continue;
+		}
+
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
 		if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
@@ -169,7 +314,12 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((((uint64_t) pte) & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)) {
+			void *frames = ptov (LARGE_PTE_ADDR (pdp[i]));
+
+			palloc_free_page (palloc_get_owner (frames));
+			palloc_free_multiple (frames, LARGE_PGCNT);
+		} else if (((uint64_t) pte) & PTE_P)
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -216,6 +366,8 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
+	if (pte && (*pte & PTE_P) && is_large_pte (pte))
+		return ptov (LARGE_PTE_ADDR (*pte)) + large_pg_ofs (uaddr);
 	if (pte && (*pte & PTE_P))
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
 	return NULL;
@@ -227,6 +379,8 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
  * from the user pool with palloc_get_page().
  * If WRITABLE is true, the new page is read/write;
  * otherwise it is read-only.
+ * With -largepages, completing a 2 MB region that qualifies
+ * promotes it to a large page; see pml4_promote().
  * Returns true if successful, false if memory allocation
  * failed. */
 bool
@@ -238,14 +392,245 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte) {
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (large_user_pages)
+			pml4_promote (pml4, upage);
+	}
 	return pte != NULL;
 }
 
+/* Maps the 2 MB user region at UPAGE in PML4 to the 2 MB of
+ * contiguous frames at kernel virtual address KPAGE, obtained
+ * from the user pool with palloc_get_multiple(), as one large
+ * page, read/write if RW is true and read-only otherwise.  Both
+ * addresses must be 2 MB aligned and no page of the region may be
+ * mapped already.
+ * Returns true if successful, false if memory allocation failed
+ * or some page of the region was already mapped. */
+bool
+pml4_set_large_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	uint64_t *pde, *pt;
+	size_t i;
+
+	ASSERT (large_pg_ofs (upage) == 0);
+	ASSERT (large_pg_ofs (vtop (kpage)) == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	pde = pml4_pde_walk (pml4, (uint64_t) upage, 1);
+	if (pde == NULL)
+		return false;
+	if (*pde & PTE_P) {
+		/* Keep an empty page table as the deposit. */
+		if (is_large_pte (pde))
+			return false;
+		pt = ptov (PTE_ADDR (*pde));
+		for (i = 0; i < LARGE_PGCNT; i++)
+			if (pt[i] & PTE_P)
+				return false;
+	} else {
+		pt = palloc_get_page (0);
+		if (pt == NULL)
+			return false;
+	}
+
+	palloc_set_owner (kpage, 1, pt);
+	*pde = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U | PTE_PS;
+	large_maps++;
+	if (rcr3 () == vtop (pml4))
+		lcr3 (rcr3 ());
+	return true;
+}
+
+/* Returns true if entry I of page table PT maps the page I pages
+ * into the region that FIRST, entry 0, starts to map, with the
+ * same permissions. */
+static bool
+continues_large (const uint64_t *pt, size_t i, uint64_t first) {
+	const uint64_t perm = PTE_P | PTE_W | PTE_U;
+
+	return (pt[i] & perm) == (first & perm)
+		&& PTE_ADDR (pt[i]) == PTE_ADDR (first) + i * PGSIZE;
+}
+
+/* Replaces the page table that maps the 2 MB user region around
+ * UPAGE in PML4 by a large page, if all 512 pages of the region
+ * are mapped, with the same permissions, to consecutive frames
+ * starting at a 2 MB boundary.  The large page is accessed or
+ * dirty if any of its pages were.  Returns true if it did. */
+bool
+pml4_promote (uint64_t *pml4, const void *upage) {
+	uint64_t *pde, *pt;
+	uint64_t first, ad = 0;
+	size_t idx = PTX (upage), i;
+
+	ASSERT (is_user_vaddr (upage));
+
+	pde = pml4_pde_walk (pml4, (uint64_t) upage, 0);
+	if (pde == NULL || !(*pde & PTE_P) || is_large_pte (pde))
+		return false;
+	pt = ptov (PTE_ADDR (*pde));
+	first = pt[0];
+	if (!(first & PTE_P) || !(first & PTE_U)
+			|| large_pg_ofs (PTE_ADDR (first)) != 0
+			|| palloc_get_owner (ptov (PTE_ADDR (first))) != NULL)
+		return false;
+
+	/* A region being filled in order fails one of these first. */
+	if ((idx > 0 && !continues_large (pt, idx - 1, first))
+			|| (idx + 1 < LARGE_PGCNT && !continues_large (pt, idx + 1, first)))
+		return false;
+	for (i = 0; i < LARGE_PGCNT; i++) {
+		if (!continues_large (pt, i, first))
+			return false;
+		ad |= pt[i] & (PTE_A | PTE_D);
+	}
+
+	palloc_set_owner (ptov (PTE_ADDR (first)), 1, pt);
+	*pde = PTE_ADDR (first) | (first & (PTE_P | PTE_W | PTE_U)) | ad | PTE_PS;
+	large_maps++;
+	if (rcr3 () == vtop (pml4))
+		lcr3 (rcr3 ());
+	return true;
+}
+
+/* Returns true if all 512 entries of page table PT map user pages
+ * with the same permissions. */
+static bool
+uniform_pt (const uint64_t *pt) {
+	const uint64_t perm = PTE_P | PTE_W | PTE_U;
+	size_t i;
+
+	if ((pt[0] & (PTE_P | PTE_U)) != (PTE_P | PTE_U))
+		return false;
+	for (i = 1; i < LARGE_PGCNT; i++)
+		if ((pt[i] & perm) != (pt[0] & perm))
+			return false;
+	return true;
+}
+
+/* Finds the first 2 MB user region at or after *VA in PML4 that
+ * is mapped entirely with 4 kB pages of the same permissions,
+ * which pml4_promote() or pml4_collapse() might turn into a
+ * large page.  Stores its address in *VA and returns true, or
+ * returns false if there is none.  *VA must be 2 MB aligned. */
+bool
+pml4_next_collapsible (uint64_t *pml4, uint64_t *va) {
+	uint64_t addr = *va;
+
+	ASSERT (large_pg_ofs (addr) == 0);
+
+	while (is_user_vaddr (addr)) {
+		uint64_t *pdpe, *pd;
+
+		if (!(pml4[PML4 (addr)] & PTE_P)) {
+			addr = (addr | ((1UL << PML4SHIFT) - 1)) + 1;
+			continue;
+		}
+		pdpe = ptov (PTE_ADDR (pml4[PML4 (addr)]));
+		if (!(pdpe[PDPE (addr)] & PTE_P)) {
+			addr = (addr | ((1UL << PDPESHIFT) - 1)) + 1;
+			continue;
+		}
+		pd = ptov (PTE_ADDR (pdpe[PDPE (addr)]));
+		if ((pd[PDX (addr)] & (PTE_P | PTE_PS)) == PTE_P
+				&& uniform_pt (ptov (PTE_ADDR (pd[PDX (addr)])))) {
+			*va = addr;
+			return true;
+		}
+		addr += LARGE_PGSIZE;
+	}
+	return false;
+}
+
+/* Copies the 512 pages of the 2 MB user region at UPAGE in PML4,
+ * which pml4_next_collapsible() found, into 2 MB of new,
+ * contiguous frames from the user pool, maps them with a large
+ * page, and frees the old frames.
+ *
+ * The process may keep running meanwhile.  Its pages are copied
+ * with their dirty bits cleared, and the copy is thrown away if
+ * any of them was written or remapped before the switch, which
+ * happens with interrupts off.  The caller must keep the kernel
+ * from unmapping pages of the region or holding on to their
+ * frames in the meantime.
+ * Returns true if the region was collapsed, false if it changed
+ * or memory ran out. */
+bool
+pml4_collapse (uint64_t *pml4, const void *upage) {
+	const uint64_t ad = PTE_A | PTE_D;
+	enum intr_level old_level;
+	uint64_t *pde, *pt, *old = NULL;
+	uint8_t *frames = NULL;
+	uint64_t bits = 0;
+	bool ok = false;
+	size_t i;
+
+	ASSERT (large_pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	pde = pml4_pde_walk (pml4, (uint64_t) upage, 0);
+	if (pde == NULL || (*pde & (PTE_P | PTE_PS)) != PTE_P)
+		return false;
+	pt = ptov (PTE_ADDR (*pde));
+	old = palloc_get_page (0);
+	frames = palloc_get_multiple (PAL_USER, LARGE_PGCNT);
+	if (old == NULL || frames == NULL)
+		goto done;
+
+	/* Snapshot the page table and clear its dirty bits. */
+	old_level = intr_disable ();
+	ok = uniform_pt (pt);
+	for (i = 0; ok && i < LARGE_PGCNT; i++) {
+		old[i] = pt[i];
+		pt[i] &= ~PTE_D;
+	}
+	if (ok && rcr3 () == vtop (pml4))
+		lcr3 (rcr3 ());
+	intr_set_level (old_level);
+	if (!ok)
+		goto done;
+
+	for (i = 0; i < LARGE_PGCNT; i++)
+		memcpy (frames + i * PGSIZE, ptov (PTE_ADDR (old[i])), PGSIZE);
+
+	old_level = intr_disable ();
+	for (i = 0; ok && i < LARGE_PGCNT; i++)
+		if ((pt[i] & ~PTE_A) != (old[i] & ~ad))
+			ok = false;
+	if (ok) {
+		for (i = 0; i < LARGE_PGCNT; i++)
+			bits |= (old[i] | pt[i]) & ad;
+		palloc_set_owner (frames, 1, pt);
+		*pde = vtop (frames) | (old[0] & (PTE_P | PTE_W | PTE_U)) | bits | PTE_PS;
+		large_maps++;
+	} else {
+		/* Give back the dirty bits of the entries left alone. */
+		for (i = 0; i < LARGE_PGCNT; i++)
+			if ((pt[i] & ~ad) == (old[i] & ~ad))
+				pt[i] |= old[i] & PTE_D;
+	}
+	if (rcr3 () == vtop (pml4))
+		lcr3 (rcr3 ());
+	intr_set_level (old_level);
+
+	if (ok) {
+		for (i = 0; i < LARGE_PGCNT; i++)
+			palloc_free_page (ptov (PTE_ADDR (old[i])));
+		frames = NULL;
+	}
+done:
+	if (frames != NULL)
+		palloc_free_multiple (frames, LARGE_PGCNT);
+	palloc_free_page (old);
+	return ok;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
- * bits in the page table entry are preserved.
+ * bits in the page table entry are preserved.  A large page
+ * around UPAGE is split first.
  * UPAGE need not be mapped. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
@@ -254,6 +639,8 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 	ASSERT (is_user_vaddr (upage));
 
 	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	if (pte != NULL && is_large_pte (pte))
+		pte = pml4e_walk (pml4, (uint64_t) upage, true);
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
@@ -273,7 +660,7 @@ pml4_is_dirty (uint64_t *pml4, const void *vpage) {
 }
 
 /* Set the dirty bit to DIRTY in the PTE for virtual page VPAGE
- * in PML4. */
+ * in PML4.  In a large page, this sets it for all of its pages. */
 void
 pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
@@ -299,7 +686,8 @@ pml4_is_accessed (uint64_t *pml4, const void *vpage) {
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  In a large page, this sets it for all of its
+   pages. */
 void
 pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
@@ -313,3 +701,10 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 			invlpg ((uint64_t) vpage);
 	}
 }
+
+/* Prints large page statistics. */
+void
+pml4_print_stats (void) {
+	printf ("Paging: %zu user large pages made, %zu split\n",
+			large_maps, large_splits);
+}
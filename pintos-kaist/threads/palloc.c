@@ -2,15 +2,19 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/alloctrack.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/spinlock.h"
 #include "threads/vaddr.h"
+#include "intrinsic.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -24,13 +28,58 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Free memory is kept as
+   blocks of 2**ORDER pages, aligned to their own size, on one
+   free list per order.  An allocation takes a block of the
+   smallest order that fits, splitting a larger one in halves if
+   need be, and hands the pages past PAGE_CNT straight back.  A
+   freed block merges with its "buddy", the other half of the
+   block it was split from, for as long as that buddy is free
+   too.  Both take time logarithmic in the block size rather
+   than linear in the pool size.
+
+   The free lists link entries of an array with one element per
+   page, kept beside the bitmap, so free pages themselves are
+   never written: the pools are populated before paging_init()
+   maps all of memory.  The pool lock is a spin lock because
+   pages are freed with interrupts off when a dying thread's page
+   goes away.
+
+   Each pool also keeps a small stack of pages that the idle
+   thread has already zeroed, so that a single-page PAL_ZERO
+   allocation, such as a new page table or the page behind an
+   anonymous page fault, need not clear the page itself.  The
+   idle thread starts refilling the stack when it holds fewer
+   than ZERO_LOW pages and stops at ZERO_HIGH.  These pages still
+   count as free: an allocation that finds no other free block
+   takes them back before failing. */
+
+/* Watermarks for each pool's stack of pre-zeroed pages. */
+#define ZERO_LOW 16
+#define ZERO_HIGH 64
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct spinlock lock;           /* Mutual exclusion. */
+	struct bitmap *used_map;        /* Bitmap of used pages. */
 	uint8_t *base;                  /* Base of pool. */
+	uint8_t *free_order;            /* Per page: 1 + order of the free
+	                                   block it starts, or 0. */
+	struct list_elem *links;        /* Per page: free list element. */
+	void **owners;                  /* Per page: palloc_set_owner(). */
+	struct list free_list[PALLOC_ORDERS]; /* Free blocks by order. */
+	size_t free_cnt;                /* Number of free pages. */
+	size_t alloc_cnt;               /* Number of allocations. */
+	uint64_t alloc_cycles;          /* TSC cycles spent allocating. */
+
+	size_t zero_pages[ZERO_HIGH];   /* Indexes of pre-zeroed pages. */
+	size_t zero_cnt;                /* Number of pre-zeroed pages. */
+	bool zero_refill;               /* Refilling up to ZERO_HIGH? */
+	size_t zero_hits;               /* PAL_ZERO pages found pre-zeroed. */
+	size_t zero_misses;             /* PAL_ZERO pages zeroed on demand. */
+	size_t zero_fills;              /* Pages zeroed by the idle thread. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -38,10 +87,22 @@ static struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* Caches of kernel pages to shrink under memory pressure. */
+#define RECLAIM_MAX 4
+static palloc_reclaim_func *reclaimers[RECLAIM_MAX];
+static size_t reclaimer_cnt;
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void *get_pages (enum palloc_flags, size_t page_cnt);
+static size_t take_zeroed (struct pool *, size_t page_cnt);
+static size_t drain_zeroed (struct pool *);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static size_t take_pages (struct pool *, size_t page_cnt);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static size_t reclaim (void);
 
 /* multiboot info */
 struct multiboot_info {
@@ -223,12 +284,12 @@ split:
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_pages (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_pages (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -258,23 +319,49 @@ palloc_init (void) {
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   FLAGS, in which case the kernel panics.  No more than
+   PALLOC_MAX_PAGES pages can be obtained at once.  If PAL_NOTRACK
+   is set, the allocation tracker does not count the pages,
+   because the caller tracks what it carves them into. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
-	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	void *pages = get_pages (flags, page_cnt);
 
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	if (!(flags & PAL_NOTRACK))
+		ALLOC_TRACK_DO (alloc_track_alloc (ALLOC_PALLOC,
+				__builtin_return_address (0), pages, PGSIZE * page_cnt));
+	return pages;
+}
+
+/* Does the work of palloc_get_multiple(). */
+static void *
+get_pages (enum palloc_flags flags, size_t page_cnt) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t page_idx = BITMAP_ERROR;
+	bool zeroed = false;
 	void *pages;
 
+	if (flags & PAL_ZERO) {
+		page_idx = take_zeroed (pool, page_cnt);
+		zeroed = page_idx != BITMAP_ERROR;
+	}
+	if (page_idx == BITMAP_ERROR)
+		page_idx = alloc_pages (pool, page_cnt);
+
+	/* Out of pages: take back the pre-zeroed ones, then make the
+	   kernel caches give theirs back, trying again after each. */
+	if (page_idx == BITMAP_ERROR && drain_zeroed (pool) > 0)
+		page_idx = alloc_pages (pool, page_cnt);
+	if (page_idx == BITMAP_ERROR && pool == &kernel_pool && reclaim () > 0)
+		page_idx = alloc_pages (pool, page_cnt);
+
 	if (page_idx != BITMAP_ERROR)
 		pages = pool->base + PGSIZE * page_idx;
 	else
 		pages = NULL;
 
 	if (pages) {
-		if (flags & PAL_ZERO)
+		if ((flags & PAL_ZERO) && !zeroed)
 			memset (pages, 0, PGSIZE * page_cnt);
 	} else {
 		if (flags & PAL_ASSERT)
@@ -293,7 +380,12 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_page (enum palloc_flags flags) {
-	return palloc_get_multiple (flags, 1);
+	void *page = get_pages (flags, 1);
+
+	if (!(flags & PAL_NOTRACK))
+		ALLOC_TRACK_DO (alloc_track_alloc (ALLOC_PALLOC,
+				__builtin_return_address (0), page, PGSIZE));
+	return page;
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -301,10 +393,12 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
 	size_t page_idx;
+	enum intr_level old_level;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
 		return;
+	ALLOC_TRACK_DO (alloc_track_free (pages));
 
 	if (page_from_pool (&kernel_pool, pages))
 		pool = &kernel_pool;
@@ -318,8 +412,12 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
-	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	memset (&pool->owners[page_idx], 0, page_cnt * sizeof *pool->owners);
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
+	free_pages (pool, page_idx, page_cnt);
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -328,23 +426,331 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Returns the pool that PAGE belongs to, or a null pointer if
+   none. */
+static struct pool *
+pool_of (const void *page) {
+	if (page_from_pool (&kernel_pool, (void *) page))
+		return &kernel_pool;
+	else if (page_from_pool (&user_pool, (void *) page))
+		return &user_pool;
+	else
+		return NULL;
+}
+
+/* Records OWNER as the owner of the PAGE_CNT allocated pages
+   starting at PAGES, for palloc_get_owner() to find.  Freeing the
+   pages forgets it. */
+void
+palloc_set_owner (void *pages, size_t page_cnt, void *owner) {
+	struct pool *pool = pool_of (pages);
+	size_t page_idx, i;
+
+	ASSERT (pool != NULL);
+	page_idx = pg_no (pages) - pg_no (pool->base);
+	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	for (i = 0; i < page_cnt; i++)
+		pool->owners[page_idx + i] = owner;
+}
+
+/* Returns the owner recorded for the page that contains ADDR, or a
+   null pointer if there is none. */
+void *
+palloc_get_owner (const void *addr) {
+	struct pool *pool = pool_of (addr);
+
+	return pool != NULL ? pool->owners[pg_no (addr) - pg_no (pool->base)]
+		: NULL;
+}
+
+/* Fills in STATS for the user pool if PAL_USER is set in FLAGS,
+   otherwise for the kernel pool. */
+void
+palloc_get_stats (enum palloc_flags flags, struct palloc_stats *stats) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	enum intr_level old_level = intr_disable ();
+	int order;
+
+	spinlock_acquire (&pool->lock);
+	stats->free_pages = pool->free_cnt + pool->zero_cnt;
+	for (order = 0; order < PALLOC_ORDERS; order++)
+		stats->free_blocks[order] = list_size (&pool->free_list[order]);
+	stats->alloc_cnt = pool->alloc_cnt;
+	stats->alloc_cycles = pool->alloc_cycles;
+	stats->zero_pages = pool->zero_cnt;
+	stats->zero_hits = pool->zero_hits;
+	stats->zero_misses = pool->zero_misses;
+	stats->zero_fills = pool->zero_fills;
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	static const char *names[] = {"kernel", "user"};
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		struct palloc_stats s;
+		int order = PALLOC_ORDERS - 1;
+
+		palloc_get_stats (i ? PAL_USER : 0, &s);
+		while (order > 0 && s.free_blocks[order] == 0)
+			order--;
+		printf ("Pages: %s pool %zu free, largest free block %zu, "
+				"%zu allocations, %llu cycles each\n", names[i],
+				s.free_pages, s.free_blocks[order] ? (size_t) 1 << order : 0,
+				s.alloc_cnt, s.alloc_cnt ? s.alloc_cycles / s.alloc_cnt : 0);
+		printf ("Pages: %s pool %zu pre-zeroed, %zu zeroed while idle, "
+				"%zu zero-fills avoided, %zu done on demand\n", names[i],
+				s.zero_pages, s.zero_fills, s.zero_hits, s.zero_misses);
+	}
+}
+
+/* Zeroes one free page for a pool that is short of pre-zeroed
+   pages, with interrupts in whatever state the caller left them.
+   Returns true if it did, false if no pool needed a page or could
+   spare one.  Called by the idle thread. */
+bool
+palloc_zero_refill (void) {
+	struct pool *pools[] = {&kernel_pool, &user_pool};
+	size_t i;
+
+	for (i = 0; i < sizeof pools / sizeof *pools; i++) {
+		struct pool *pool = pools[i];
+		size_t page_idx = BITMAP_ERROR;
+		enum intr_level old_level;
+
+		old_level = intr_disable ();
+		spinlock_acquire (&pool->lock);
+		if (pool->zero_cnt < ZERO_LOW)
+			pool->zero_refill = true;
+		if (pool->zero_refill && pool->free_cnt > ZERO_HIGH)
+			page_idx = take_pages (pool, 1);
+		spinlock_release (&pool->lock);
+		intr_set_level (old_level);
+		if (page_idx == BITMAP_ERROR)
+			continue;
+
+		memset (pool->base + PGSIZE * page_idx, 0, PGSIZE);
+
+		old_level = intr_disable ();
+		spinlock_acquire (&pool->lock);
+		if (pool->zero_cnt < ZERO_HIGH) {
+			pool->zero_pages[pool->zero_cnt++] = page_idx;
+			pool->zero_fills++;
+			if (pool->zero_cnt == ZERO_HIGH)
+				pool->zero_refill = false;
+		} else
+			free_pages (pool, page_idx, 1);
+		spinlock_release (&pool->lock);
+		intr_set_level (old_level);
+		return true;
+	}
+	return false;
+}
+
+/* Registers FUNC to be called to free cached kernel pages when
+   the kernel pool runs out. */
+void
+palloc_register_reclaim (palloc_reclaim_func *func) {
+	ASSERT (func != NULL);
+	ASSERT (reclaimer_cnt < RECLAIM_MAX);
+
+	reclaimers[reclaimer_cnt++] = func;
+}
+
+/* Asks every registered cache to give back its pages.  Returns
+   the number of pages freed. */
+static size_t
+reclaim (void) {
+	size_t freed = 0;
+	size_t i;
+
+	for (i = 0; i < reclaimer_cnt; i++)
+		freed += reclaimers[i] ();
+	return freed;
+}
+
+/* Returns the free list element for page PAGE_IDX of POOL. */
+static struct list_elem *
+page_elem (struct pool *pool, size_t page_idx) {
+	return &pool->links[page_idx];
+}
+
+/* Returns the index of a pre-zeroed page of POOL, if PAGE_CNT is
+   1 and there is one, or BITMAP_ERROR, counting the PAGE_CNT
+   pages as zeroed on demand. */
+static size_t
+take_zeroed (struct pool *pool, size_t page_cnt) {
+	uint64_t start = rdtsc ();
+	enum intr_level old_level;
+	size_t page_idx = BITMAP_ERROR;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
+	if (page_cnt == 1 && pool->zero_cnt > 0) {
+		page_idx = pool->zero_pages[--pool->zero_cnt];
+		pool->zero_hits++;
+		pool->alloc_cnt++;
+		pool->alloc_cycles += rdtsc () - start;
+	} else
+		pool->zero_misses += page_cnt;
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
+	return page_idx;
+}
+
+/* Returns all of POOL's pre-zeroed pages to its free lists and
+   returns how many there were. */
+static size_t
+drain_zeroed (struct pool *pool) {
+	enum intr_level old_level;
+	size_t cnt;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
+	cnt = pool->zero_cnt;
+	while (pool->zero_cnt > 0)
+		free_pages (pool, pool->zero_pages[--pool->zero_cnt], 1);
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
+	return cnt;
+}
+
+/* Takes PAGE_CNT pages out of POOL's free lists and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt) {
+	uint64_t start = rdtsc ();
+	enum intr_level old_level;
+	size_t page_idx;
+
+	if (page_cnt == 0 || page_cnt > PALLOC_MAX_PAGES)
+		return BITMAP_ERROR;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
+	page_idx = take_pages (pool, page_cnt);
+	if (page_idx != BITMAP_ERROR) {
+		pool->alloc_cnt++;
+		pool->alloc_cycles += rdtsc () - start;
+	}
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
+	return page_idx;
+}
+
+/* Does the work of alloc_pages() without counting it.  POOL's
+   lock must be held. */
+static size_t
+take_pages (struct pool *pool, size_t page_cnt) {
+	size_t page_idx = BITMAP_ERROR;
+	int order = 0, o;
+
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+
+	for (o = order; o < PALLOC_ORDERS; o++)
+		if (!list_empty (&pool->free_list[o]))
+			break;
+	if (o < PALLOC_ORDERS) {
+		struct list_elem *e = list_pop_front (&pool->free_list[o]);
+
+		page_idx = e - pool->links;
+		pool->free_order[page_idx] = 0;
+
+		/* Split off the upper halves we do not need. */
+		while (o > order) {
+			o--;
+			pool->free_order[page_idx + ((size_t) 1 << o)] = o + 1;
+			list_push_front (&pool->free_list[o],
+					page_elem (pool, page_idx + ((size_t) 1 << o)));
+		}
+		bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << order,
+				true);
+		pool->free_cnt -= (size_t) 1 << order;
+
+		/* Give back the pages past PAGE_CNT. */
+		if (page_cnt < ((size_t) 1 << order))
+			free_pages (pool, page_idx + page_cnt,
+					((size_t) 1 << order) - page_cnt);
+	}
+	return page_idx;
+}
+
+/* Returns the PAGE_CNT used pages starting at PAGE_IDX to POOL's
+   free lists, as the largest aligned blocks that fit, merging
+   each with its buddies.  POOL's lock must be held, except while
+   the pools are being populated. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t base_no = pg_no (pool->base);
+	size_t pool_cnt = bitmap_size (pool->used_map);
+	size_t end = page_idx + page_cnt;
+
+	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool->free_cnt += page_cnt;
+
+	while (page_idx < end) {
+		size_t idx = page_idx;
+		int order = 0;
+
+		/* Blocks are aligned in physical memory, not within the
+		   pool, so that large blocks can be mapped as large pages. */
+		while (order < PALLOC_ORDERS - 1
+				&& (base_no + page_idx) % ((size_t) 2 << order) == 0
+				&& page_idx + ((size_t) 2 << order) <= end)
+			order++;
+		page_idx += (size_t) 1 << order;
+
+		for (; order < PALLOC_ORDERS - 1; order++) {
+			size_t buddy = ((base_no + idx) ^ ((size_t) 1 << order)) - base_no;
+
+			if (buddy >= pool_cnt || pool->free_order[buddy] != order + 1)
+				break;
+			list_remove (page_elem (pool, buddy));
+			pool->free_order[buddy] = 0;
+			if (buddy < idx)
+				idx = buddy;
+		}
+		pool->free_order[idx] = order + 1;
+		list_push_front (&pool->free_list[order], page_elem (pool, idx));
+	}
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map and per-page arrays at its
+     base.  Calculate the space needed for them
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t order_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
+	size_t link_pages = ROUND_UP (pgcnt * sizeof *p->links, PGSIZE);
+	size_t owner_pages = ROUND_UP (pgcnt * sizeof *p->owners, PGSIZE);
+	int order;
 
-	lock_init(&p->lock);
+	spinlock_init (&p->lock, "pool->lock");
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->free_order = *bm_base + bm_pages;
+	memset (p->free_order, 0, pgcnt);
+	p->links = *bm_base + bm_pages + order_pages;
+	p->owners = *bm_base + bm_pages + order_pages + link_pages;
+	memset (p->owners, 0, pgcnt * sizeof *p->owners);
+	for (order = 0; order < PALLOC_ORDERS; order++)
+		list_init (&p->free_list[order]);
+	p->free_cnt = p->alloc_cnt = p->alloc_cycles = 0;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
 
-	*bm_base += bm_pages;
+	*bm_base += bm_pages + order_pages + link_pages + owner_pages;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -0,0 +1,240 @@
+#include "threads/schedtrace.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Scheduler latency tracer.
+
+   Enabled with the -schedtrace kernel option.  While it is on,
+   every wakeup and every context switch is logged, stamped with
+   the TSC, to a ring buffer of the current CPU.  Events are only
+   logged with interrupts off, so each ring has a single writer
+   and needs no lock: the writer fills the slot at the head, then
+   advances the head, overwriting the oldest event once the ring
+   is full.
+
+   The tracer also keeps two log2 histograms for each of the last
+   SCHED_STATS_CNT threads to run, in TSC cycles:
+
+   - Run delay: from the moment the thread became ready (woken by
+     thread_unblock(), or preempted or yielding) to the moment it
+     got the CPU.
+
+   - On-CPU: from switching in to switching out.
+
+   sched_trace_print() dumps both at power off in a line-oriented
+   format that utils/sched-timeline turns into a timeline. */
+
+#define SCHED_RING_PAGES 16             /* Ring size per CPU, in pages. */
+#define SCHED_RING_CNT (SCHED_RING_PAGES * PGSIZE / sizeof (struct sched_event))
+#define SCHED_STATS_CNT 128             /* Threads with histograms. */
+#define SCHED_HIST_CNT 32               /* log2 cycle buckets. */
+
+/* One logged event. */
+struct sched_event {
+	uint64_t tsc;               /* Time stamp. */
+	int32_t tid;                /* Thread the event is about. */
+	uint8_t type;               /* enum sched_event_type. */
+	uint8_t priority;           /* Thread's priority at the time. */
+	uint8_t arg;                /* Switch out: enum sched_out_reason.
+	                               Wakeup: 1 if from an interrupt. */
+	uint8_t pad;
+};
+
+/* One CPU's event ring. */
+struct sched_ring {
+	struct sched_event *events; /* SCHED_RING_CNT events. */
+	uint64_t head;              /* Number of events ever logged. */
+};
+
+struct sched_stats {
+	tid_t tid;                  /* Thread, or 0 if unused. */
+	char name[16];              /* Thread name. */
+	uint64_t switches;          /* Times switched in. */
+	uint32_t run_delay[SCHED_HIST_CNT];
+	uint32_t on_cpu[SCHED_HIST_CNT];
+};
+
+/* Set by -schedtrace. */
+bool sched_trace_enabled;
+
+static struct sched_ring rings[CPU_MAX];
+static struct sched_stats stats[SCHED_STATS_CNT];
+static size_t stats_next;       /* Next slot to hand out. */
+
+/* Allocates the event rings.  Turns tracing off if there is not
+   enough memory. */
+void
+sched_trace_init (void) {
+	unsigned id;
+
+	if (!sched_trace_enabled)
+		return;
+	for (id = 0; id < cpu_cnt; id++) {
+		rings[id].events = palloc_get_multiple (PAL_ZERO, SCHED_RING_PAGES);
+		if (rings[id].events == NULL) {
+			printf ("schedtrace: out of memory, tracing disabled\n");
+			sched_trace_enabled = false;
+			return;
+		}
+	}
+}
+
+/* Logs an event of TYPE about T. */
+static void
+log_event (enum sched_event_type type, struct thread *t, int arg,
+		uint64_t tsc) {
+	struct sched_ring *ring = &rings[this_cpu ()->id];
+	struct sched_event *e;
+
+	if (ring->events == NULL)
+		return;
+	e = &ring->events[ring->head % SCHED_RING_CNT];
+	e->tsc = tsc;
+	e->tid = t->tid;
+	e->type = type;
+	e->priority = t->priority;
+	e->arg = arg;
+	barrier ();
+	ring->head++;
+}
+
+/* Returns T's histograms, taking over the least recently handed
+   out slot if T has none yet. */
+static struct sched_stats *
+get_stats (struct thread *t) {
+	struct sched_stats *s = t->sched_stats;
+
+	if (s == NULL || s->tid != t->tid) {
+		s = &stats[stats_next++ % SCHED_STATS_CNT];
+		memset (s, 0, sizeof *s);
+		s->tid = t->tid;
+		strlcpy (s->name, t->name, sizeof s->name);
+		t->sched_stats = s;
+	}
+	return s;
+}
+
+/* Adds CYCLES to histogram HIST. */
+static void
+hist_add (uint32_t hist[SCHED_HIST_CNT], uint64_t cycles) {
+	int bucket = 0;
+
+	while (cycles >>= 1)
+		bucket++;
+	hist[bucket < SCHED_HIST_CNT ? bucket : SCHED_HIST_CNT - 1]++;
+}
+
+/* Records that T, which was blocked, is now ready. */
+void
+sched_trace_wakeup (struct thread *t) {
+	uint64_t now = rdtsc ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	t->ready_at = now;
+	log_event (SCHED_WAKEUP, t, intr_context (), now);
+}
+
+/* Returns why PREV, which is about to be switched out, stopped
+   running. */
+static enum sched_out_reason
+out_reason (struct thread *prev) {
+	switch (prev->status) {
+		case THREAD_READY:
+			return SCHED_OUT_YIELD;
+		case THREAD_DYING:
+			return SCHED_OUT_EXIT;
+		default:
+			if (prev->wait_on_lock != NULL || prev->wait_on_rwlock != NULL)
+				return SCHED_OUT_LOCK;
+			if (prev->wait_queue != NULL)
+				return SCHED_OUT_WAIT;
+			return SCHED_OUT_SLEEP;
+	}
+}
+
+/* Records a switch from PREV to NEXT. */
+void
+sched_trace_switch (struct thread *prev, struct thread *next) {
+	uint64_t now = rdtsc ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (prev->run_at != 0)
+		hist_add (get_stats (prev)->on_cpu, now - prev->run_at);
+	if (prev->status == THREAD_READY)
+		prev->ready_at = now;
+	log_event (SCHED_SWITCH_OUT, prev, out_reason (prev), now);
+
+	if (next->ready_at != 0)
+		hist_add (get_stats (next)->run_delay, now - next->ready_at);
+	get_stats (next)->switches++;
+	next->run_at = now;
+	log_event (SCHED_SWITCH_IN, next, 0, now);
+}
+
+/* Prints the nonempty buckets of HIST after LABEL. */
+static void
+hist_print (const char *label, const uint32_t hist[SCHED_HIST_CNT]) {
+	int i;
+
+	printf (" %s", label);
+	for (i = 0; i < SCHED_HIST_CNT; i++)
+		if (hist[i] != 0)
+			printf (" %d:%u", i, hist[i]);
+}
+
+/* Dumps the histograms and event rings.  Each line starts with
+   "schedtrace:".  Histogram lines give "BUCKET:COUNT" pairs,
+   where a BUCKET of N counts times of 2**N to 2**(N+1) cycles:
+
+     schedtrace: thread TID "NAME" switches N run-delay ... on-cpu ...
+
+   followed by every event still in the rings, oldest first:
+
+     schedtrace: event CPU TSC TYPE TID PRIORITY ARG */
+void
+sched_trace_print (void) {
+	unsigned id;
+	size_t i;
+
+	if (!sched_trace_enabled)
+		return;
+
+	/* Stop logging, so that printing does not overwrite the
+	   events being printed. */
+	sched_trace_enabled = false;
+
+	printf ("schedtrace: begin cpus %u ring %zu\n", cpu_cnt,
+			(size_t) SCHED_RING_CNT);
+	for (i = 0; i < SCHED_STATS_CNT; i++) {
+		struct sched_stats *s = &stats[i];
+		if (s->tid == 0)
+			continue;
+		printf ("schedtrace: thread %d \"%s\" switches %llu", s->tid,
+				s->name, s->switches);
+		hist_print ("run-delay", s->run_delay);
+		hist_print ("on-cpu", s->on_cpu);
+		printf ("\n");
+	}
+	for (id = 0; id < cpu_cnt; id++) {
+		struct sched_ring *ring = &rings[id];
+		uint64_t n = ring->head < SCHED_RING_CNT ? 0
+			: ring->head - SCHED_RING_CNT;
+
+		if (ring->events == NULL)
+			continue;
+		for (; n < ring->head; n++) {
+			struct sched_event *e = &ring->events[n % SCHED_RING_CNT];
+			printf ("schedtrace: event %u %llu %c %d %u %u\n", id, e->tsc,
+					e->type, e->tid, e->priority, e->arg);
+		}
+	}
+	printf ("schedtrace: end\n");
+}
@@ -0,0 +1,275 @@
+#include "threads/slab.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator, after Bonwick's.
+
+   malloc() rounds every request up to a power of 2, so an object
+   of 72 bytes takes 128.  A slab cache instead hands out objects
+   of one exact size, packed into page-sized "slabs".  Each slab
+   starts with a header and a bitmap of its free objects; the
+   objects follow.
+
+   A cache may have a constructor, which runs once on every object
+   when its slab is created rather than on every allocation.  An
+   object must therefore be back in its constructed state when it
+   is freed, and slab_alloc() does not clear it.
+
+   The bytes a slab has left over after its objects go in front of
+   them, a cache line more in each new slab than in the last, so
+   that the first objects of different slabs do not all compete
+   for the same cache sets ("cache coloring").
+
+   Each cache keeps its slabs on three lists: partially used,
+   full and empty.  Allocation prefers partial slabs, so that
+   empty ones stay empty, and empty slabs are given back to the
+   page allocator only by slab_reclaim(), which the page
+   allocator calls when the kernel pool runs dry. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Cache line size, the unit of coloring. */
+#define CACHE_LINE 64
+
+/* Slab header, at the start of each slab's page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct slab_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* In one of the cache's lists. */
+	uint8_t *objs;              /* First object. */
+	size_t free_cnt;            /* Number of free objects. */
+	struct bitmap *free_map;    /* Bit set for each free object. */
+};
+
+/* Slab cache. */
+struct slab_cache {
+	const char *name;           /* Name, for statistics. */
+	size_t obj_size;            /* Object size, rounded up. */
+	size_t objs_per_slab;       /* Objects in a slab. */
+	size_t hdr_size;            /* Header and bitmap size. */
+	size_t color_max;           /* Largest color offset. */
+	size_t color_next;          /* Color offset of the next slab. */
+	slab_ctor_func *ctor;       /* Constructor, or null. */
+	struct list_elem elem;      /* In all_caches. */
+
+	struct lock lock;           /* Protects the rest. */
+	struct list partial;        /* Slabs with free and used objects. */
+	struct list full;           /* Slabs without free objects. */
+	struct list empty;          /* Slabs without used objects. */
+	size_t slab_cnt;            /* Slabs on all three lists. */
+	size_t in_use;              /* Objects allocated. */
+	long long allocs;           /* Successful allocations. */
+};
+
+/* All caches, protected by caches_lock. */
+static struct list all_caches;
+static struct lock caches_lock;
+
+/* Returns the size of a slab header followed by a bitmap for
+   OBJ_CNT objects. */
+static size_t
+hdr_size (size_t obj_cnt) {
+	return ROUND_UP (sizeof (struct slab) + bitmap_buf_size (obj_cnt),
+			sizeof (uint64_t));
+}
+
+/* Initializes the slab allocator. */
+void
+slab_init (void) {
+	list_init (&all_caches);
+	lock_init (&caches_lock);
+	palloc_register_reclaim (slab_reclaim);
+}
+
+/* Creates and returns a cache of SIZE-byte objects named NAME.
+   If CTOR is nonnull, it constructs each object when its slab is
+   created.  Caches are created while the kernel boots, so this
+   panics if memory is not available. */
+struct slab_cache *
+slab_cache_create (const char *name, size_t size, slab_ctor_func *ctor) {
+	struct slab_cache *c;
+	size_t n;
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		PANIC ("slab_cache_create: out of memory");
+
+	c->name = name;
+	c->obj_size = ROUND_UP (size > 0 ? size : 1, sizeof (uint64_t));
+	n = (PGSIZE - sizeof (struct slab)) / c->obj_size;
+	while (n > 0 && hdr_size (n) + n * c->obj_size > PGSIZE)
+		n--;
+	ASSERT (n > 0);
+	c->objs_per_slab = n;
+	c->hdr_size = hdr_size (n);
+	c->color_max = ROUND_DOWN (PGSIZE - c->hdr_size - n * c->obj_size,
+			CACHE_LINE);
+	c->color_next = 0;
+	c->ctor = ctor;
+
+	lock_init (&c->lock);
+	list_init (&c->partial);
+	list_init (&c->full);
+	list_init (&c->empty);
+	c->slab_cnt = c->in_use = 0;
+	c->allocs = 0;
+
+	lock_acquire (&caches_lock);
+	list_push_back (&all_caches, &c->elem);
+	lock_release (&caches_lock);
+	return c;
+}
+
+/* Creates a slab for cache C with its objects COLOR bytes past
+   the header and constructs them.  Returns the new slab, or a
+   null pointer if memory is not available. */
+static struct slab *
+new_slab (struct slab_cache *c, size_t color) {
+	struct slab *s = palloc_get_page (0);
+	size_t i;
+
+	if (s == NULL)
+		return NULL;
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->objs = (uint8_t *) s + c->hdr_size + color;
+	s->free_cnt = c->objs_per_slab;
+	s->free_map = bitmap_create_in_buf (c->objs_per_slab, s + 1,
+			c->hdr_size - sizeof *s);
+	bitmap_set_all (s->free_map, true);
+	if (c->ctor != NULL)
+		for (i = 0; i < c->objs_per_slab; i++)
+			c->ctor (s->objs + i * c->obj_size);
+	return s;
+}
+
+/* Obtains and returns an object from cache C, in its constructed
+   state.  Returns a null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *c) {
+	struct slab *s;
+	size_t idx;
+
+	lock_acquire (&c->lock);
+	if (list_empty (&c->partial) && list_empty (&c->empty)) {
+		size_t color = c->color_next;
+
+		c->color_next = color + CACHE_LINE <= c->color_max
+			? color + CACHE_LINE : 0;
+
+		/* Constructors may take a while, so build the slab without
+		   the lock. */
+		lock_release (&c->lock);
+		s = new_slab (c, color);
+		if (s == NULL)
+			return NULL;
+		lock_acquire (&c->lock);
+		list_push_front (&c->empty, &s->elem);
+		c->slab_cnt++;
+	}
+
+	s = list_entry (list_front (list_empty (&c->partial) ? &c->empty
+				: &c->partial), struct slab, elem);
+	idx = bitmap_scan_and_flip (s->free_map, 0, 1, true);
+	ASSERT (idx != BITMAP_ERROR);
+	list_remove (&s->elem);
+	list_push_front (--s->free_cnt == 0 ? &c->full : &c->partial, &s->elem);
+	c->in_use++;
+	c->allocs++;
+	lock_release (&c->lock);
+
+	return s->objs + idx * c->obj_size;
+}
+
+/* Returns OBJ, which must have been obtained from cache C with
+   slab_alloc() and be in its constructed state, to C. */
+void
+slab_free (struct slab_cache *c, void *obj) {
+	struct slab *s = pg_round_down (obj);
+	size_t ofs, idx;
+
+	if (obj == NULL)
+		return;
+
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+	ofs = (uint8_t *) obj - s->objs;
+	idx = ofs / c->obj_size;
+	ASSERT (ofs % c->obj_size == 0 && idx < c->objs_per_slab);
+
+	lock_acquire (&c->lock);
+	ASSERT (!bitmap_test (s->free_map, idx));
+	bitmap_mark (s->free_map, idx);
+	list_remove (&s->elem);
+	list_push_front (++s->free_cnt == c->objs_per_slab ? &c->empty
+			: &c->partial, &s->elem);
+	c->in_use--;
+	lock_release (&c->lock);
+}
+
+/* Gives the pages of every cache's empty slabs back to the page
+   allocator and returns the number of pages freed.  Registered
+   with palloc_register_reclaim(), and may also be called by the
+   VM when memory runs short. */
+size_t
+slab_reclaim (void) {
+	struct list_elem *e;
+	size_t freed = 0;
+
+	lock_acquire (&caches_lock);
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+
+		lock_acquire (&c->lock);
+		while (!list_empty (&c->empty)) {
+			struct slab *s = list_entry (list_pop_front (&c->empty),
+					struct slab, elem);
+
+			s->magic = 0;
+			palloc_free_page (s);
+			c->slab_cnt--;
+			freed++;
+		}
+		lock_release (&c->lock);
+	}
+	lock_release (&caches_lock);
+	return freed;
+}
+
+/* Fills in STATS for cache C. */
+void
+slab_get_stats (struct slab_cache *c, struct slab_stats *stats) {
+	lock_acquire (&c->lock);
+	stats->obj_size = c->obj_size;
+	stats->objs_per_slab = c->objs_per_slab;
+	stats->slab_cnt = c->slab_cnt;
+	stats->in_use = c->in_use;
+	stats->allocs = c->allocs;
+	lock_release (&c->lock);
+}
+
+/* Prints statistics for every cache. */
+void
+slab_print_stats (void) {
+	struct list_elem *e;
+
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+
+		printf ("Slab: %s: %zu of %zu %zu-byte objects in use, %zu slabs, "
+				"%lld allocations\n", c->name, c->in_use,
+				c->slab_cnt * c->objs_per_slab, c->obj_size, c->slab_cnt,
+				c->allocs);
+	}
+}
@@ -0,0 +1,48 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Initializes LOCK, named NAME, as unheld. */
+void
+spinlock_init (struct spinlock *lock, const char *name) {
+	ASSERT (lock != NULL);
+
+	lock->locked = 0;
+	lock->holder = NULL;
+	lock->name = name;
+}
+
+/* Acquires LOCK, spinning until it becomes available.  The lock
+   must not already be held by the current CPU.  Interrupts must
+   be off. */
+void
+spinlock_acquire (struct spinlock *lock) {
+	ASSERT (lock != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!spinlock_held_by_current_cpu (lock));
+
+	while (__atomic_exchange_n (&lock->locked, 1, __ATOMIC_ACQUIRE))
+		while (lock->locked)
+			asm volatile ("pause" : : : "memory");
+	lock->holder = this_cpu ();
+}
+
+/* Releases LOCK, which must be held by the current CPU. */
+void
+spinlock_release (struct spinlock *lock) {
+	ASSERT (lock != NULL);
+	ASSERT (spinlock_held_by_current_cpu (lock));
+
+	lock->holder = NULL;
+	__atomic_store_n (&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+/* Returns true if the current CPU holds LOCK, false otherwise. */
+bool
+spinlock_held_by_current_cpu (const struct spinlock *lock) {
+	ASSERT (lock != NULL);
+
+	return lock->locked && lock->holder == this_cpu ();
+}
@@ -31,6 +31,20 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
+
+#ifdef LOCK_PROFILE
+static struct lock_class *lock_class_get (const char *name);
+static void lock_class_acquired (struct lock_class *, uint64_t *acquired_at);
+static void lock_class_waited (struct lock_class *, uint64_t start);
+static void lock_class_released (struct lock_class *, uint64_t acquired_at);
+
+/* Runs STMT if the lock profiler is on.  Without LOCK_PROFILE the
+   profiler is not compiled in at all. */
+#define PROFILE(STMT) do { if (lock_profile) { STMT; } } while (0)
+#else
+#define PROFILE(STMT) ((void) 0)
+#endif
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -46,7 +60,10 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	pq_init (&sema->waiters);
+#ifdef LOCK_PROFILE
+	sema->class = NULL;
+#endif
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -66,11 +83,15 @@ sema_down (struct semaphore *sema) {
 
 	old_level = intr_disable ();
 	struct thread *t = thread_current();
+#ifdef LOCK_PROFILE
+	uint64_t wait_start = sema->value == 0 ? rdtsc () : 0;
+#endif
 	while (sema->value == 0) {
-		list_push_back(&sema->waiters, &thread_current()->elem);
-		// list_insert_ordered(&sema->waiters, &thread_current()->elem, more_priority, NULL);
+		pq_push (&sema->waiters, &t->wait_elem, t->priority);
+		t->wait_queue = &sema->waiters;
 		thread_block ();
 	}
+	PROFILE (lock_class_waited (sema->class, wait_start));
 	sema->value--;
 	intr_set_level (old_level);
 }
@@ -111,15 +132,14 @@ sema_up (struct semaphore *sema) {
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
-	list_sort(&sema->waiters, more_priority, NULL);
 	sema->value++;
-	if (!list_empty (&sema->waiters)){
-		t = list_entry (list_pop_front (&sema->waiters), struct thread, elem);
-		thread_unblock(t);	
-		thread_yield();
+	if (!pq_empty (&sema->waiters)){
+		t = pq_entry (pq_pop (&sema->waiters), struct thread, wait_elem);
+		t->wait_queue = NULL;
+		thread_unblock(t);
 	}
-	// printf("is empty : %d\n" , list_empty (&sema->waiters));
 	intr_set_level (old_level);
+	thread_preempt ();
 }
 
 static void sema_test_helper (void *sema_);
@@ -171,13 +191,20 @@ sema_test_helper (void *sema_) {
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   NAME is only used by the lock profiler, which adds up the
+   statistics of all locks with the same name.  The lock_init()
+   macro names a lock after the expression it is passed. */
 void
-lock_init (struct lock *lock) {
+lock_init_named (struct lock *lock, const char *name UNUSED) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+#ifdef LOCK_PROFILE
+	lock->semaphore.class = lock_class_get (name);
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -195,18 +222,24 @@ lock_acquire (struct lock *lock) {
 	ASSERT (!lock_held_by_current_thread (lock));
 	
 	struct thread *curr = thread_current();
-	// printf("current_running_thread : %d\n", curr->priority);
-	if (lock->holder){ // lock holder보다 current의 우선순위가 높으면, donate
-		if (lock->holder->priority < curr->priority){
-			curr->wait_on_lock = lock;
-			list_insert_ordered(&lock->holder->donations, &curr->d_elem, more_priority, NULL);
-			donate_priority();
-		}
+	enum intr_level old_level = intr_disable ();
+	if (lock->holder && !thread_mlfqs){ // lock holder보다 current의 우선순위가 높으면, donate
+		curr->wait_on_lock = lock;
+		donate_priority();
 	}
-	
+
 	sema_down (&lock->semaphore);
 	curr->wait_on_lock = NULL;
-	lock->holder = thread_current();
+	lock->holder = curr;
+
+	/* Whoever is still queued keeps donating through LOCK. */
+	struct pq_elem *top = pq_max (&lock->semaphore.waiters);
+	pq_push (&curr->held_locks, &lock->held_elem,
+			top != NULL ? top->key : PRI_MIN - 1);
+	if (top != NULL && top->key > curr->priority && !thread_mlfqs)
+		thread_update_priority (curr, top->key);
+	PROFILE (lock_class_acquired (lock->semaphore.class, &lock->acquired_at));
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -217,14 +250,21 @@ lock_acquire (struct lock *lock) {
    interrupt handler. */
 bool
 lock_try_acquire (struct lock *lock) {
+	enum intr_level old_level;
 	bool success;
 
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
 	success = sema_try_down (&lock->semaphore);
-	if (success)
+	if (success) {
 		lock->holder = thread_current ();
+		pq_push (&lock->holder->held_locks, &lock->held_elem, PRI_MIN - 1);
+		PROFILE (lock_class_acquired (lock->semaphore.class,
+					&lock->acquired_at));
+	}
+	intr_set_level (old_level);
 	return success;
 }
 
@@ -239,10 +279,14 @@ void
 lock_release (struct lock *lock) {
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
-	
+
+	enum intr_level old_level = intr_disable ();
+	PROFILE (lock_class_released (lock->semaphore.class, lock->acquired_at));
 	remove_donators(lock);
-	restore_priority();
+	if (!thread_mlfqs)
+		restore_priority();
 	lock->holder = NULL;
+	intr_set_level (old_level);
 	sema_up (&lock->semaphore);
 }
 
@@ -256,9 +300,264 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+/* Initializes RW as a free reader-writer lock.
+
+   Everything about an rwlock is done with interrupts off, as for
+   semaphores, so taking a free or read-held lock for reading is
+   only a few list and queue operations and never sleeps; only a
+   thread that must wait goes through the scheduler.  Waiters are
+   kept by priority.  A thread that has to wait donates its
+   priority to every current holder: to the writer, or to all of
+   the readers, and from each of them on down any chain of locks
+   they are waiting for.
+
+   NAME is only used by the lock profiler, as for locks. */
+void
+rwlock_init_named (struct rwlock *rw, const char *name UNUSED) {
+	ASSERT (rw != NULL);
+
+	list_init (&rw->readers);
+	rw->writer = NULL;
+	pq_init (&rw->read_waiters);
+	pq_init (&rw->write_waiters);
+#ifdef LOCK_PROFILE
+	rw->class = lock_class_get (name);
+#endif
+}
+
+/* Returns the highest priority waiting for RW, or PRI_MIN - 1 if
+   nothing is waiting. */
+static int
+rw_waiter_priority (struct rwlock *rw) {
+	struct pq_elem *r = pq_max (&rw->read_waiters);
+	struct pq_elem *w = pq_max (&rw->write_waiters);
+	int priority = PRI_MIN - 1;
+
+	if (r != NULL && r->key > priority)
+		priority = r->key;
+	if (w != NULL && w->key > priority)
+		priority = w->key;
+	return priority;
+}
+
+/* Returns true if T holds RW for reading. */
+static bool
+rw_reading (struct rwlock *rw, struct thread *t) {
+	struct list_elem *e;
+
+	for (e = list_begin (&rw->readers); e != list_end (&rw->readers);
+			e = list_next (e))
+		if (list_entry (e, struct rw_hold, elem)->thread == t)
+			return true;
+	return false;
+}
+
+/* Makes T a reader of RW through HOLD. */
+static void
+rw_grant_read (struct rwlock *rw, struct thread *t, struct rw_hold *hold) {
+	hold->rwlock = rw;
+	hold->thread = t;
+	list_push_back (&rw->readers, &hold->elem);
+	pq_push (&t->held_locks, &hold->held_elem, rw_waiter_priority (rw));
+	PROFILE (lock_class_acquired (rw->class, &hold->acquired_at));
+}
+
+/* Makes T the writer of RW. */
+static void
+rw_grant_write (struct rwlock *rw, struct thread *t) {
+	int priority = rw_waiter_priority (rw);
+
+	rw->writer = t;
+	pq_push (&t->held_locks, &rw->held_elem, priority);
+	PROFILE (lock_class_acquired (rw->class, &rw->acquired_at));
+	if (priority > t->priority && !thread_mlfqs)
+		thread_update_priority (t, priority);
+}
+
+/* Donates PRIORITY to holder T through its hold element E. */
+static void
+rw_donate (struct thread *t, struct pq_elem *e, int priority) {
+	if (e->key < priority)
+		pq_rekey (&t->held_locks, e, priority);
+	if (t->priority < priority) {
+		thread_update_priority (t, priority);
+		donate_priority_chain (t, priority);
+	}
+}
+
+/* Donates PRIORITY, that of a thread waiting for RW, to every
+   holder of RW and on down any chains they are waiting in.
+   Interrupts must be off. */
+void
+rwlock_donate (struct rwlock *rw, int priority) {
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (thread_mlfqs)
+		return;
+	if (rw->writer != NULL)
+		rw_donate (rw->writer, &rw->held_elem, priority);
+	for (e = list_begin (&rw->readers); e != list_end (&rw->readers);
+			e = list_next (e)) {
+		struct rw_hold *hold = list_entry (e, struct rw_hold, elem);
+		rw_donate (hold->thread, &hold->held_elem, priority);
+	}
+}
+
+/* Puts the running thread to sleep on QUEUE, one of RW's wait
+   queues, until a releaser grants it RW, donating its priority to
+   RW's holders meanwhile. */
+static void
+rw_wait (struct rwlock *rw, struct pqueue *queue) {
+	struct thread *curr = thread_current ();
+#ifdef LOCK_PROFILE
+	uint64_t wait_start = rdtsc ();
+#endif
+
+	pq_push (queue, &curr->wait_elem, curr->priority);
+	curr->wait_queue = queue;
+	curr->wait_on_rwlock = rw;
+	rwlock_donate (rw, curr->dl ? PRI_MAX : curr->priority);
+	thread_block ();
+	PROFILE (lock_class_waited (rw->class, wait_start));
+}
+
+/* Removes and returns the highest-priority thread in QUEUE. */
+static struct thread *
+rw_pop (struct pqueue *queue) {
+	struct thread *t = pq_entry (pq_pop (queue), struct thread, wait_elem);
+
+	t->wait_queue = NULL;
+	t->wait_on_rwlock = NULL;
+	return t;
+}
+
+/* Hands RW, which has just become free, to the highest-priority
+   waiting writer or, if there is none, to every waiting reader. */
+static void
+rw_hand_off (struct rwlock *rw) {
+	if (!pq_empty (&rw->write_waiters)) {
+		struct thread *t = rw_pop (&rw->write_waiters);
+		rw_grant_write (rw, t);
+		thread_unblock (t);
+	} else
+		while (!pq_empty (&rw->read_waiters)) {
+			struct thread *t = rw_pop (&rw->read_waiters);
+			rw_grant_read (rw, t, t->read_hold);
+			t->read_hold = NULL;
+			thread_unblock (t);
+		}
+}
+
+/* Acquires RW for reading through HOLD, sleeping while a writer
+   holds it or waits for it.  HOLD must stay valid until it is
+   passed to rwlock_release_read().  The current thread must not
+   already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw, struct rw_hold *hold) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (hold != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != curr);
+
+	old_level = intr_disable ();
+	ASSERT (!rw_reading (rw, curr));
+	if (rw->writer == NULL && pq_empty (&rw->write_waiters))
+		rw_grant_read (rw, curr, hold);
+	else {
+		curr->read_hold = hold;
+		rw_wait (rw, &rw->read_waiters);
+	}
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for reading
+   through HOLD. */
+void
+rwlock_release_read (struct rwlock *rw, struct rw_hold *hold) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (hold != NULL);
+	ASSERT (hold->rwlock == rw && hold->thread == curr);
+
+	old_level = intr_disable ();
+	PROFILE (lock_class_released (rw->class, hold->acquired_at));
+	list_remove (&hold->elem);
+	pq_remove (&curr->held_locks, &hold->held_elem);
+	hold->rwlock = NULL;
+	if (!thread_mlfqs)
+		restore_priority ();
+	if (list_empty (&rw->readers))
+		rw_hand_off (rw);
+	intr_set_level (old_level);
+	thread_preempt ();
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != curr);
+
+	old_level = intr_disable ();
+	ASSERT (!rw_reading (rw, curr));
+	if (rw->writer == NULL && list_empty (&rw->readers))
+		rw_grant_write (rw, curr);
+	else {
+		rw_wait (rw, &rw->write_waiters);
+	}
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rw->writer == curr);
+
+	old_level = intr_disable ();
+	PROFILE (lock_class_released (rw->class, rw->acquired_at));
+	pq_remove (&curr->held_locks, &rw->held_elem);
+	rw->writer = NULL;
+	if (!thread_mlfqs)
+		restore_priority ();
+	rw_hand_off (rw);
+	intr_set_level (old_level);
+	thread_preempt ();
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool
+rwlock_held_for_write (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return rw->writer == thread_current ();
+}
+
+/* One semaphore in a condition's wait queue. */
 struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
+	struct pq_elem elem;                /* Wait queue element. */
+	struct thread *thread;              /* Waiting thread. */
 	struct semaphore semaphore;         /* This semaphore. */
 };
 
@@ -269,7 +568,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	pq_init (&cond->waiters);
 }
 
 
@@ -295,22 +594,10 @@ cond_init (struct condition *cond) {
    we need to sleep. */
 
 
-bool cond_more_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-	// struct thread *t;
-
-	struct semaphore_elem* s_a = list_entry(a, struct semaphore_elem, elem);
-	struct semaphore_elem* s_b = list_entry(b, struct semaphore_elem, elem);
-	
-	struct thread *st_a = list_entry(list_begin(&s_a->semaphore.waiters), struct thread, elem);
-    struct thread *st_b = list_entry(list_begin(&s_b->semaphore.waiters), struct thread, elem);
-
-    return st_a->priority > st_b->priority;
-}
-
 void
 cond_wait (struct condition *cond, struct lock *lock) {
-
 	struct semaphore_elem waiter;
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
@@ -318,23 +605,13 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	ASSERT (lock_held_by_current_thread (lock));
 
 	sema_init (&waiter.semaphore, 0);
+	waiter.thread = thread_current ();
 
-	// list_push_back(&cond->waiters, &waiter.elem);
-	// list_sort(&cond->waiters, cond_more_priority);
-// 	struct semaphore_elem {
-// 	struct list_elem elem;              /* List element. */
-// 	struct semaphore semaphore;         /* This semaphore. */
-// };
-	
-	list_insert_ordered(&cond->waiters, &waiter.elem, cond_more_priority, 0);
-	
-							// priority를 참조할 방법을 찾아야 함
-	
-	// printf("priority : %d inserted to cond->waiters\n", list_entry(&waiter.elem, struct thread, elem)->priority);
-	// struct thread *holder = lock->holder;
-	// printf("lock holder priority : %d \n", holder->priority);
-
-	// list_insert_ordered(&cond->waiters, &waiter.elem, more_priority, NULL);
+	old_level = intr_disable ();
+	pq_push (&cond->waiters, &waiter.elem, waiter.thread->priority);
+	waiter.thread->cond_queue = &cond->waiters;
+	waiter.thread->cond_elem = &waiter.elem;
+	intr_set_level (old_level);
 
 	lock_release (lock);
 	sema_down (&waiter.semaphore);
@@ -357,10 +634,14 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
-	if (!list_empty (&cond->waiters)){
-		list_sort(&cond->waiters, cond_more_priority, 0);
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+
+	if (!pq_empty (&cond->waiters)){
+		enum intr_level old_level = intr_disable ();
+		struct semaphore_elem *waiter =
+			pq_entry (pq_pop (&cond->waiters), struct semaphore_elem, elem);
+		waiter->thread->cond_queue = NULL;
+		intr_set_level (old_level);
+		sema_up (&waiter->semaphore);
 	}
 }
 
@@ -376,6 +657,174 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!pq_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Lock profiler.
+
+   Built in only with LOCK_PROFILE defined (make LOCK_PROFILE=1)
+   and switched on with the -lockprof kernel option.  Every lock
+   and rwlock belongs to the lock class for its name, so the
+   locks of, say, all malloc descriptors ("&d->lock") show up as
+   one line.  For each class we count acquisitions and those that
+   had to wait, and keep totals, maxima and log2 histograms of
+   wait and hold times in TSC cycles.  The statistics are only
+   touched with interrupts off.  lock_print_stats() dumps them at
+   power off, sorted by total wait. */
+
+#ifdef LOCK_PROFILE
+#define LOCK_CLASS_CNT 64               /* Distinct lock names. */
+#define LOCK_HIST_CNT 32                /* log2 cycle buckets. */
+
+struct lock_class {
+	const char *name;
+	uint64_t acquired;                  /* Acquisitions. */
+	uint64_t contended;                 /* Acquisitions that waited. */
+	uint64_t wait_total, wait_max;      /* Cycles spent waiting. */
+	uint64_t hold_total, hold_max;      /* Cycles held. */
+	uint32_t wait_hist[LOCK_HIST_CNT];  /* Waits by log2 cycles. */
+	uint32_t hold_hist[LOCK_HIST_CNT];  /* Holds by log2 cycles. */
+};
+
+/* True to collect statistics.  Set by -lockprof. */
+bool lock_profile;
+
+static struct lock_class lock_classes[LOCK_CLASS_CNT];
+static size_t lock_class_cnt;
+
+/* Catches every name once lock_classes is full. */
+static struct lock_class lock_class_other = { .name = "(other)" };
+
+/* Returns the lock class for NAME, creating it if necessary. */
+static struct lock_class *
+lock_class_get (const char *name) {
+	struct lock_class *class = &lock_class_other;
+	enum intr_level old_level;
+	size_t i;
+
+	if (name == NULL)
+		return class;
+	if (*name == '&')
+		name++;
+
+	old_level = intr_disable ();
+	for (i = 0; i < lock_class_cnt; i++)
+		if (!strcmp (lock_classes[i].name, name)) {
+			class = &lock_classes[i];
+			break;
+		}
+	if (i == lock_class_cnt && lock_class_cnt < LOCK_CLASS_CNT) {
+		class = &lock_classes[lock_class_cnt++];
+		class->name = name;
+	}
+	intr_set_level (old_level);
+	return class;
+}
+
+/* Adds CYCLES to histogram HIST. */
+static void
+hist_add (uint32_t hist[LOCK_HIST_CNT], uint64_t cycles) {
+	int bucket = 0;
+
+	while (cycles >>= 1)
+		bucket++;
+	hist[bucket < LOCK_HIST_CNT ? bucket : LOCK_HIST_CNT - 1]++;
+}
+
+/* Records an acquisition of a lock in CLASS, stamping
+   *ACQUIRED_AT with the time. */
+static void
+lock_class_acquired (struct lock_class *class, uint64_t *acquired_at) {
+	if (class == NULL)
+		return;
+	class->acquired++;
+	*acquired_at = rdtsc ();
+}
+
+/* Records a wait for a lock in CLASS that began at START.  Does
+   nothing if START is 0, meaning there was no wait. */
+static void
+lock_class_waited (struct lock_class *class, uint64_t start) {
+	uint64_t cycles;
+
+	if (class == NULL || start == 0)
+		return;
+	cycles = rdtsc () - start;
+	class->contended++;
+	class->wait_total += cycles;
+	if (cycles > class->wait_max)
+		class->wait_max = cycles;
+	hist_add (class->wait_hist, cycles);
+}
+
+/* Records the release of a lock in CLASS acquired at
+   ACQUIRED_AT. */
+static void
+lock_class_released (struct lock_class *class, uint64_t acquired_at) {
+	uint64_t cycles;
+
+	if (class == NULL)
+		return;
+	cycles = rdtsc () - acquired_at;
+	class->hold_total += cycles;
+	if (cycles > class->hold_max)
+		class->hold_max = cycles;
+	hist_add (class->hold_hist, cycles);
+}
+
+/* Prints the nonempty buckets of HIST after LABEL. */
+static void
+hist_print (const char *label, const uint32_t hist[LOCK_HIST_CNT]) {
+	int i;
+
+	printf ("  %s:", label);
+	for (i = 0; i < LOCK_HIST_CNT; i++)
+		if (hist[i] != 0)
+			printf (" 2^%d:%u", i, hist[i]);
+	printf ("\n");
+}
+#endif /* LOCK_PROFILE */
+
+/* Prints lock profiling statistics, if the profiler is on. */
+void
+lock_print_stats (void) {
+#ifdef LOCK_PROFILE
+	struct lock_class *sorted[LOCK_CLASS_CNT + 1];
+	size_t cnt = 0;
+	size_t i, j;
+
+	if (!lock_profile)
+		return;
+
+	/* Insertion sort by total wait, largest first. */
+	for (i = 0; i <= lock_class_cnt; i++) {
+		struct lock_class *c = i < lock_class_cnt
+			? &lock_classes[i] : &lock_class_other;
+		if (c->acquired == 0)
+			continue;
+		for (j = cnt; j > 0 && sorted[j - 1]->wait_total < c->wait_total; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = c;
+		cnt++;
+	}
+
+	printf ("Lock profile (TSC cycles):\n");
+	printf ("%-20s %9s %9s %13s %11s %13s %11s\n", "lock", "acquired",
+			"contended", "wait total", "wait max", "hold total", "hold max");
+	for (i = 0; i < cnt; i++) {
+		struct lock_class *c = sorted[i];
+		printf ("%-20s %9llu %9llu %13llu %11llu %13llu %11llu\n", c->name,
+				c->acquired, c->contended, c->wait_total, c->wait_max,
+				c->hold_total, c->hold_max);
+	}
+	for (i = 0; i < cnt; i++) {
+		struct lock_class *c = sorted[i];
+		if (c->contended == 0)
+			continue;
+		printf ("%s:\n", c->name);
+		hist_print ("wait", c->wait_hist);
+		hist_print ("hold", c->hold_hist);
+	}
+#endif
+}
@@ -2,14 +2,20 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/schedtrace.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,24 +30,27 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* Waiting List & Sleep List*/
-static struct list sleep_list;
+/* The kernel stack shares struct thread's page, so keep it small.
+   See the big comment at the top of thread.h. */
+_Static_assert (sizeof (struct thread) <= 1024,
+		"struct thread leaves too little room for the kernel stack");
+
+/* Per-CPU data, including the run queues of processes in
+   THREAD_READY state, that is, processes that are ready to run
+   but not actually running.  See cpu.h. */
+struct cpu cpus[CPU_MAX];
+unsigned cpu_cnt = 1;
+
+/* Sleeping threads, keyed by wakeup tick.  A timing wheel keeps
+   both thread_sleep() and the per-tick wake_up() O(1). */
+static struct timer_wheel sleep_wheel;
+static struct spinlock sleep_lock;
 void thread_sleep(int64_t ticks);
 void wake_up(int64_t ticks);
 void remove_donators(struct lock *lock);
 void restore_priority();
 void donate_priority();
 
-bool more_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
-bool less_ticks(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
-
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
@@ -65,14 +74,62 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* MLFQS system load: estimated average number of threads ready
+   to run over the past minute. */
+static fixed_t load_avg;
+
+/* MLFQS recent_cpu decay.  Once a second every thread's
+   recent_cpu becomes COEF * recent_cpu + nice, where COEF depends
+   on load_avg.  Only threads that can run are decayed on the
+   spot.  A blocked thread's recent_cpu and priority cannot
+   matter until it wakes up, so it remembers how many decays it
+   has had in decay_sec and catches up in thread_unblock(), using
+   the coefficients of the last DECAY_HISTORY seconds kept here.
+   That keeps the per-second work proportional to the number of
+   runnable threads rather than the number of threads. */
+#define DECAY_HISTORY 256
+static fixed_t decay_coefs[DECAY_HISTORY];
+static int64_t decay_cnt;       /* # of once-a-second decays so far. */
+
+/* Deadline scheduling class.  A deadline thread reserves RUNTIME
+   ticks of CPU time in every PERIOD ticks, to be received within
+   DEADLINE ticks of the start of the period.  Deadline threads run
+   earliest deadline first, ahead of the priority classes, on the
+   CPU where they joined the class.  Admission control keeps the
+   bandwidth, RUNTIME / PERIOD, reserved on each CPU at or below
+   DL_BW_MAX per mille, so that the reservations can be met and
+   the priority classes are not starved.  A thread that uses up
+   its budget is throttled until its next period. */
+#define DL_BW_MAX 950
+
 static void kernel_thread (thread_func *, void *aux);
+static void thread_entry (void) NO_RETURN;
 
 static void idle (void *aux UNUSED);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static struct thread *ready_queue_pop (struct cpu *);
+static int ready_queue_max_priority (struct cpu *);
+static bool should_preempt (struct cpu *, struct thread *);
+static int dl_key (int64_t deadline);
+static int dl_bw (const struct thread *);
+static void dl_new_job (struct thread *, int64_t release);
+static void dl_wakeup (struct thread *);
+static void dl_leave (struct thread *);
+static void dl_replenish (struct cpu *, int64_t now);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_second (void);
+static void mlfqs_catch_up (struct thread *);
+static int mlfqs_priority (const struct thread *);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+static size_t thread_cache_reclaim (void);
+static void count_create (uint64_t cycles);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -118,15 +175,25 @@ thread_init (void) {
 
 	/* Init the globla thread context */
 	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&sleep_list);
+	for (unsigned id = 0; id < CPU_MAX; id++) {
+		struct cpu *c = &cpus[id];
+
+		c->id = id;
+		spinlock_init (&c->rq_lock, "run queue");
+		for (int i = 0; i < PRI_CNT; i++)
+			list_init (&c->ready_queues[i]);
+		pq_init (&c->dl_queue);
+		list_init (&c->dl_throttled);
+		spinlock_init (&c->thread_cache_lock, "thread cache");
+	}
+	palloc_register_reclaim (thread_cache_reclaim);
+	timer_wheel_init (&sleep_wheel, 0);
+	spinlock_init (&sleep_lock, "sleep wheel");
 	list_init (&destruction_req);
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
-	
-	initial_thread->wakeup_ticks = 0;
 	initial_thread->tid = allocate_tid ();
 }
 
@@ -142,7 +209,7 @@ thread_start (void) {
 	/* Start preemptive thread scheduling. */
 	intr_enable ();
 
-	/* Wait for the idle thread to initialize idle_thread. */
+	/* Wait for the idle thread to initialize this CPU's idle_thread. */
 	sema_down (&idle_started);
 }
 
@@ -153,7 +220,7 @@ thread_tick (void) {
 	struct thread *t = thread_current ();
 
 	/* Update statistics. */
-	if (t == idle_thread)
+	if (t == this_cpu ()->idle_thread)
 		idle_ticks++;
 #ifdef USERPROG
 	else if (t->pml4 != NULL)
@@ -162,6 +229,17 @@ thread_tick (void) {
 	else
 		kernel_ticks++;
 
+	if (thread_mlfqs)
+		mlfqs_tick (t);
+
+	/* Charge a deadline thread for the tick, and throttle it once
+	   its budget is gone. */
+	if (t->dl && --t->dl_budget <= 0) {
+		t->dl_throttled = true;
+		t->dl_throttles++;
+		intr_yield_on_return ();
+	}
+
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
@@ -172,6 +250,20 @@ void
 thread_print_stats (void) {
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+
+	long long creates = 0, hits = 0;
+	uint64_t cycles = 0, cycles_max = 0;
+	for (unsigned id = 0; id < cpu_cnt; id++) {
+		creates += cpus[id].thread_creates;
+		hits += cpus[id].thread_cache_hits;
+		cycles += cpus[id].create_cycles;
+		if (cpus[id].create_cycles_max > cycles_max)
+			cycles_max = cpus[id].create_cycles_max;
+	}
+	if (creates > 0)
+		printf ("Thread: %lld created, %lld from cache, "
+				"%llu cycles avg, %llu cycles max\n",
+				creates, hits, cycles / creates, cycles_max);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -192,13 +284,15 @@ thread_print_stats (void) {
 tid_t
 thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
+	struct switch_frame *frame;
 	struct thread *t;
 	tid_t tid;
+	uint64_t start = rdtsc ();
 
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = thread_page_get ();
 	if (t == NULL)
 		return TID_ERROR;
 
@@ -207,6 +301,7 @@ thread_create (const char *name, int priority,
 	t->fdt = palloc_get_multiple(PAL_ZERO, FDT_PAGES);
 	
 	if (t->fdt == NULL){
+		thread_page_put (t);
 		return TID_ERROR;
 	}
 	t->next_fd = 2;
@@ -226,12 +321,20 @@ thread_create (const char *name, int priority,
 	t->tf.ss = SEL_KDSEG;
 	t->tf.cs = SEL_KCSEG;
 	t->tf.eflags = FLAG_IF;
+
+	/* The first switch to T "returns" into thread_entry(), which
+	   launches T from its intr_frame.  The frame ends where T's
+	   stack begins, which keeps the stack aligned as the ABI
+	   requires on entry to a function. */
+	frame = (struct switch_frame *) (t->tf.rsp - sizeof *frame);
+	frame->rip = thread_entry;
+	t->switch_rsp = (uint64_t) frame;
 	
 	list_push_back(&thread_current()->children, &t->child_elem);
+	count_create (rdtsc () - start);
 	/* Add to run queue. */
 	thread_unblock (t);
-	if (thread_current()->priority < t->priority)
-		thread_yield();
+	thread_preempt ();
 
 	return tid;
 }
@@ -268,8 +371,14 @@ thread_unblock (struct thread *t) {
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	list_push_back (&ready_list, &t->elem);
+	if (thread_mlfqs)
+		mlfqs_catch_up (t);
+	if (t->dl)
+		dl_wakeup (t);
+	ready_queue_push (t);
 	t->status = THREAD_READY;
+	if (sched_trace_enabled)
+		sched_trace_wakeup (t);
 	intr_set_level (old_level);
 
 }
@@ -314,107 +423,207 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	if (thread_current ()->fpu_alloc != NULL)
+		fpu_release (thread_current ());
+
+	/* process_exit() frees the descriptor table of a process;
+	   plain kernel threads still own theirs. */
+	if (thread_current ()->fdt != NULL) {
+		palloc_free_multiple (thread_current ()->fdt, FDT_PAGES);
+		thread_current ()->fdt = NULL;
+	}
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
+	dl_leave (thread_current ());
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
 
 
+/* Donates the running thread's priority to the holder of the
+   lock it is about to wait for, and on down the chain of holders
+   that are themselves waiting for locks, up to 8 levels deep.  A
+   holder waiting for an rwlock passes the donation on to all of
+   that rwlock's holders.
+   Each lock on the way is re-keyed in its holder's held_locks and
+   thread_update_priority() re-keys each holder in the queue it
+   waits in, so no wait queue ever has to be re-sorted.
+   Interrupts must be off. */
 void donate_priority(){
 	struct thread *curr = thread_current();
 
+	/* A deadline thread outranks every priority, so it donates
+	   the highest. */
+	donate_priority_chain (curr, curr->dl ? PRI_MAX : curr->priority);
+}
+
+/* Donates PRIORITY to the holder of the lock that T is waiting
+   for, if any, and on down the chain as donate_priority() does.
+   Interrupts must be off. */
+void donate_priority_chain(struct thread *curr, int priority){
+	ASSERT (intr_get_level () == INTR_OFF);
+
 	for (int depth=0; depth<8; depth++){
-		if (!curr->wait_on_lock) break;
-		struct thread *holder = curr->wait_on_lock->holder;
-		holder->priority = curr->priority;
+		if (curr->wait_on_rwlock != NULL) {
+			rwlock_donate (curr->wait_on_rwlock, priority);
+			break;
+		}
+		struct lock *lock = curr->wait_on_lock;
+		if (lock == NULL || lock->holder == NULL) break;
+		struct thread *holder = lock->holder;
+		if (lock->held_elem.key < priority)
+			pq_rekey (&holder->held_locks, &lock->held_elem, priority);
+		if (holder->priority >= priority) break;
+		thread_update_priority (holder, priority);
 		curr = holder;
 	}
 }
 
+/* Drops whatever was donated through LOCK, which the running
+   thread is about to release.  Interrupts must be off. */
 void remove_donators(struct lock *lock){
-	// 1) 현재 lock의 holder의 donations를 순회한다
-	// 2) 순회하면서 각 쓰레드의 wait_on_lock이 현재 lock이라면, donations에서 제거한다.
-
-	struct thread *t;
-	if (!list_empty(&lock->holder->donations)){
-		struct list_elem *temp = list_begin(&lock->holder->donations);
-		for (temp; temp != list_end(&lock->holder->donations); temp = list_next(temp)){
-			t = list_entry(temp, struct thread, d_elem);
-			if (t->wait_on_lock == lock){
-				list_remove(&t->d_elem);
-			}
-		}
-	}
+	ASSERT (intr_get_level () == INTR_OFF);
+	pq_remove (&lock->holder->held_locks, &lock->held_elem);
 }
 
+/* Sets the running thread's priority to the higher of its own
+   and the largest donation through a lock it still holds, which
+   is the top of held_locks. */
 void restore_priority() {
 	struct thread *curr = thread_current();
-	
-	curr->priority = curr->original_priority;
+	struct pq_elem *top = pq_max (&curr->held_locks);
+	int priority = curr->original_priority;
+
+	if (top != NULL && top->key > priority)
+		priority = top->key;
+	thread_update_priority (curr, priority);
+}
 
-	if (!list_empty (&curr -> donations)){
-		list_sort (&curr->donations, more_priority, 0);
-		struct thread *t = list_entry(list_front (&curr->donations), struct thread, d_elem);
+/* Sets T's effective priority to PRIORITY.  If T is sitting in
+   the run queue it is moved to the queue for its new priority,
+   so the run queue never needs to be re-sorted. */
+void
+thread_update_priority (struct thread *t, int priority) {
+	enum intr_level old_level;
 
-		if (t->priority > curr->priority)
-			curr->priority = t->priority;
-	}
-	
+	ASSERT (is_thread (t));
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	old_level = intr_disable ();
+	if (t->status == THREAD_READY && t->priority != priority) {
+		ready_queue_remove (t);
+		t->priority = priority;
+		ready_queue_push (t);
+	} else
+		t->priority = priority;
+
+	/* Keep T's place in the queues it is waiting in. */
+	if (t->wait_queue != NULL)
+		pq_rekey (t->wait_queue, &t->wait_elem, priority);
+	if (t->cond_queue != NULL)
+		pq_rekey (t->cond_queue, t->cond_elem, priority);
+	intr_set_level (old_level);
 }
 
+/* Yields the CPU if a thread of higher priority than the running
+   thread is ready.  In an external interrupt handler the yield
+   is deferred until the handler returns. */
+void
+thread_preempt (void) {
+	enum intr_level old_level = intr_disable ();
+	bool preempt = should_preempt (this_cpu (), thread_current ());
+
+	if (preempt && intr_context ())
+		intr_yield_on_return ();
+	intr_set_level (old_level);
+
+	if (preempt && !intr_context ())
+		thread_yield ();
+}
 
 
-/* Wake the thread up. the current thread is moved from the sleep list to the ready list */
-void wake_up(int64_t ticks){
-	if (list_empty(&sleep_list))
-	    return;
-	struct list_elem* temp = list_begin(&sleep_list);
-	struct thread *t;
 
+/* Wake the thread up. every thread whose wakeup tick is at or
+   before TICKS is moved from the sleep wheel to the run queue */
+void wake_up(int64_t ticks){
+	struct list expired;
 	enum intr_level old_level;
+
 	old_level = intr_disable();
-	
-	for (temp; temp != list_end(&sleep_list); ){
-		t = list_entry(temp, struct thread, elem);
-		if (t->wakeup_ticks <= ticks){
-			temp = list_next(temp);
-			list_remove(&t->elem);
-			thread_unblock(t);
-		}
-		else {
-			break;
-		}
-	}
-	list_sort(&ready_list, more_priority, NULL);
+	list_init (&expired);
+	spinlock_acquire (&sleep_lock);
+	timer_wheel_advance (&sleep_wheel, ticks, &expired);
+	spinlock_release (&sleep_lock);
+	dl_replenish (this_cpu (), ticks);
 	intr_set_level(old_level);
+
+	/* The expired threads are ours alone now, so they can be made
+	   ready one at a time, letting interrupts in between. */
+	while (!list_empty (&expired)) {
+		struct timer_wheel_elem *e =
+			list_entry (list_pop_front (&expired), struct timer_wheel_elem, elem);
+		thread_unblock (timer_wheel_entry (e, struct thread, sleep_elem));
+	}
+	thread_preempt ();
 }
 
-bool more_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-    struct thread *st_a = list_entry(a, struct thread, elem);
-    struct thread *st_b = list_entry(b, struct thread, elem);
-    return st_a->priority > st_b->priority;
+/* Returns a lower bound on the tick at which the next sleeping
+   thread must be woken up, or a throttled deadline thread on this
+   CPU given new budget, or INT64_MAX if there is no such thread.
+   Interrupts must be off. */
+int64_t
+thread_next_wakeup (void) {
+	struct cpu *c = this_cpu ();
+	struct list_elem *e;
+	int64_t next;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	spinlock_acquire (&sleep_lock);
+	next = timer_wheel_next_expiry (&sleep_wheel);
+	spinlock_release (&sleep_lock);
+
+	spinlock_acquire (&c->rq_lock);
+	for (e = list_begin (&c->dl_throttled); e != list_end (&c->dl_throttled);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, elem);
+		if (t->dl_next < next)
+			next = t->dl_next;
+	}
+	spinlock_release (&c->rq_lock);
+	return next;
 }
 
-bool less_ticks(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-    struct thread *st_a = list_entry(a, struct thread, elem);
-    struct thread *st_b = list_entry(b, struct thread, elem);
-    return st_a->wakeup_ticks < st_b->wakeup_ticks;
+/* Accounts for CNT timer ticks that the idle thread spent waiting
+   without a timer interrupt, in tickless mode. */
+void
+thread_idle_ticks (int64_t cnt) {
+	idle_ticks += cnt;
+
+	/* Nothing ran, but load_avg still decays once a second. */
+	if (thread_mlfqs) {
+		int64_t now = timer_ticks ();
+		int64_t t;
+
+		for (t = now - cnt + 1; t <= now; t++)
+			if (t % TIMER_FREQ == 0)
+				mlfqs_second ();
+	}
 }
 
-/* Sleep the thread. the current thread is put to sleep until wakeup_ticks */
+/* Sleep the thread. the current thread is put to sleep until tick TICKS */
 void 
 thread_sleep(int64_t ticks){
 	struct thread *curr = thread_current ();
 	enum intr_level old_level;
 	ASSERT (!intr_context ());
 	old_level = intr_disable ();
-	curr->wakeup_ticks = ticks;
 	
-	if (curr != idle_thread){
-		list_insert_ordered(&sleep_list, &curr->elem, less_ticks, NULL);
+	if (curr != this_cpu ()->idle_thread){
+		spinlock_acquire (&sleep_lock);
+		timer_wheel_insert (&sleep_wheel, &curr->sleep_elem, ticks);
+		spinlock_release (&sleep_lock);
 		do_schedule(THREAD_BLOCKED);
 	}
 	else{ // idle thread
@@ -434,8 +643,8 @@ thread_yield (void) {
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
-	if (curr != idle_thread)
-		list_push_back (&ready_list, &curr->elem);
+	if (curr != this_cpu ()->idle_thread)
+		ready_queue_push (curr);
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
 }
@@ -443,6 +652,10 @@ thread_yield (void) {
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) {
+	/* The MLFQS computes priorities itself. */
+	if (thread_mlfqs)
+		return;
+
 	if (thread_current()->priority != thread_current()->original_priority){ // donate 받은 경우
 		thread_current()->original_priority = new_priority;
 	}
@@ -450,8 +663,8 @@ thread_set_priority (int new_priority) {
 	thread_current ()->original_priority = new_priority;
 	thread_current ()->priority = new_priority;
 	}
-	thread_yield();
-	
+	thread_preempt ();
+
 }
 
 /* Returns the current thread's priority. */
@@ -462,45 +675,101 @@ thread_get_priority (void) {
 
 /* Sets the current thread's nice value to NICE. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	else if (nice > NICE_MAX)
+		nice = NICE_MAX;
+
+	old_level = intr_disable ();
+	curr->nice = nice;
+	if (thread_mlfqs)
+		curr->priority = mlfqs_priority (curr);
+	intr_set_level (old_level);
+	thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int load = fp_round (load_avg * 100);
+	intr_set_level (old_level);
+	return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int recent_cpu = fp_round (thread_current ()->recent_cpu * 100);
+	intr_set_level (old_level);
+	return recent_cpu;
+}
+
+/* Puts the running thread in the deadline class, with a budget
+   of RUNTIME ticks in every PERIOD ticks, to be received within
+   DEADLINE ticks of the start of each period, or, if RUNTIME is
+   0, takes it out of the class.  Returns false, changing nothing,
+   if the parameters are not 0 < RUNTIME <= DEADLINE <= PERIOD or
+   if the CPU cannot admit the bandwidth RUNTIME / PERIOD on top of
+   what the other deadline threads on it have reserved. */
+bool
+thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	int bw = 0;
+
+	if (runtime != 0) {
+		if (runtime < 0 || deadline < runtime || period < deadline)
+			return false;
+		bw = DIV_ROUND_UP (runtime * 1000, period);
+	}
+
+	old_level = intr_disable ();
+	if (curr->cpu->dl_bw - dl_bw (curr) + bw > DL_BW_MAX) {
+		intr_set_level (old_level);
+		return false;
+	}
+	dl_leave (curr);
+	if (runtime != 0) {
+		curr->dl = true;
+		curr->dl_runtime = runtime;
+		curr->dl_rel_deadline = deadline;
+		curr->dl_period = period;
+		curr->cpu->dl_bw += bw;
+		dl_new_job (curr, timer_ticks ());
+	}
+	intr_set_level (old_level);
+
+	/* Leaving the class may leave us outranked. */
+	thread_preempt ();
+	return true;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it initializes its CPU's idle_thread, "up"s the
+   semaphore passed to it to enable thread_start() to continue,
+   and immediately blocks.  After that, the idle thread never appears in the
+   run queue.  It is returned by next_thread_to_run() as a
+   special case when the run queue is empty. */
 static void
 idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
 
-	idle_thread = thread_current ();
+	this_cpu ()->idle_thread = thread_current ();
 	sema_up (idle_started);
 
 	for (;;) {
@@ -508,6 +777,19 @@ idle (void *idle_started_ UNUSED) {
 		intr_disable ();
 		thread_block ();
 
+		/* Zero free pages ahead of PAL_ZERO allocations, one at a
+		   time, until there are enough or a thread becomes ready. */
+		intr_enable ();
+		while (this_cpu ()->ready_cnt == 0 && palloc_zero_refill ())
+			continue;
+		intr_disable ();
+
+		/* An interrupt may have readied a thread since the last
+		   check.  Run it now rather than halting until the next
+		   interrupt, which in tickless mode may be far off. */
+		if (this_cpu ()->ready_cnt != 0)
+			continue;
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -519,8 +801,11 @@ idle (void *idle_started_ UNUSED) {
 		   time.
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-		   7.11.1 "HLT Instruction". */
-		asm volatile ("sti; hlt" : : : "memory");
+		   7.11.1 "HLT Instruction".
+
+		   timer_idle() does exactly that, but in tickless mode it
+		   may first stop the periodic timer tick. */
+		timer_idle ();
 	}
 }
 
@@ -545,12 +830,11 @@ init_thread (struct thread *t, const char *name, int priority) {
 	
 	memset (t, 0, sizeof *t);
 	t->status = THREAD_BLOCKED;
-	t->wakeup_ticks = 0;
 	strlcpy (t->name, name, sizeof t->name);
 	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 	
 	list_init (&t->children);
-	list_init (&t->donations);
+	pq_init (&t->held_locks);
 
 	sema_init (&t->fork_sema, 0);
 	sema_init (&t->free_sema, 0);
@@ -558,27 +842,370 @@ init_thread (struct thread *t, const char *name, int priority) {
 
 	t->exit_status = 0;
 	t->running_file = NULL;
+#ifdef USERPROG
+	t->leader = t;
+	lock_init (&t->group_lock);
+	cond_init (&t->group_cond);
+	list_init (&t->group);
+#endif
 	t->wait_on_lock = NULL;
+	t->wait_on_rwlock = NULL;
 	t->priority = priority;
 	t->original_priority = priority;
+	t->cpu = this_cpu ();
+
+	/* A new thread inherits its creator's niceness and recent CPU
+	   time.  Under the MLFQS that, not PRIORITY, sets its priority. */
+	t->nice = NICE_DEFAULT;
+	if (t != running_thread ()) {
+		t->nice = running_thread ()->nice;
+		t->recent_cpu = running_thread ()->recent_cpu;
+	}
+	t->decay_sec = decay_cnt;
+	if (thread_mlfqs)
+		t->priority = t->original_priority = mlfqs_priority (t);
 	
 	
 	t->magic = THREAD_MAGIC;
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   return a thread from the current CPU's run queue, unless the
+   run queue is empty.  (If the running thread can continue
+   running, then it will be in the run queue.)  If the run queue
+   is empty, returns the CPU's idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else{
-		list_sort(&ready_list, more_priority, NULL);
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	struct cpu *c = this_cpu ();
+	struct thread *t = ready_queue_pop (c);
+
+	return t != NULL ? t : c->idle_thread;
+}
+
+/* Appends T to the run queue of its priority level on T's CPU,
+   or, if T is a deadline thread, to the deadline run queue or the
+   throttled list. */
+static void
+ready_queue_push (struct thread *t) {
+	struct cpu *c = t->cpu;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&c->rq_lock);
+	if (t->dl_throttled)
+		list_push_back (&c->dl_throttled, &t->elem);
+	else if (t->dl) {
+		pq_push (&c->dl_queue, &t->dl_elem, dl_key (t->dl_deadline));
+		c->ready_cnt++;
+	} else {
+		list_push_back (&c->ready_queues[t->priority - PRI_MIN], &t->elem);
+		c->ready_mask |= 1ULL << (t->priority - PRI_MIN);
+		c->ready_cnt++;
 	}
+	spinlock_release (&c->rq_lock);
+}
+
+/* Removes T, which must be in the run queue, from the run queue. */
+static void
+ready_queue_remove (struct thread *t) {
+	struct cpu *c = t->cpu;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&c->rq_lock);
+	if (t->dl_throttled)
+		list_remove (&t->elem);
+	else if (t->dl) {
+		pq_remove (&c->dl_queue, &t->dl_elem);
+		c->ready_cnt--;
+	} else {
+		list_remove (&t->elem);
+		if (list_empty (&c->ready_queues[t->priority - PRI_MIN]))
+			c->ready_mask &= ~(1ULL << (t->priority - PRI_MIN));
+		c->ready_cnt--;
+	}
+	spinlock_release (&c->rq_lock);
+}
+
+/* Removes and returns the highest-priority thread in C's run
+   queue, or returns a null pointer if the queue is empty.
+   Deadline threads are not considered.  C's run queue lock must
+   be held. */
+static struct thread *
+ready_queue_pop_locked (struct cpu *c) {
+	struct list *queue;
+	struct thread *t;
+
+	ASSERT (spinlock_held_by_current_cpu (&c->rq_lock));
+
+	if (c->ready_mask == 0)
+		return NULL;
+	queue = &c->ready_queues[63 - __builtin_clzll (c->ready_mask)];
+	t = list_entry (list_pop_front (queue), struct thread, elem);
+	if (list_empty (queue))
+		c->ready_mask &= ~(1ULL << (t->priority - PRI_MIN));
+	c->ready_cnt--;
+	return t;
+}
+
+/* Removes and returns the deadline thread with the earliest
+   deadline in C's run queue, if any, and otherwise the
+   highest-priority thread, or returns a null pointer if the queue
+   is empty. */
+static struct thread *
+ready_queue_pop (struct cpu *c) {
+	struct thread *t;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&c->rq_lock);
+	if (!pq_empty (&c->dl_queue)) {
+		t = pq_entry (pq_pop (&c->dl_queue), struct thread, dl_elem);
+		c->ready_cnt--;
+	} else
+		t = ready_queue_pop_locked (c);
+	spinlock_release (&c->rq_lock);
+	return t;
+}
+
+/* Returns the highest priority among threads ready on C, or
+   PRI_MIN - 1 if C's run queue is empty.  The answer may be
+   stale as soon as it is returned if other CPUs are running. */
+static int
+ready_queue_max_priority (struct cpu *c) {
+	uint64_t mask = c->ready_mask;
+
+	if (mask == 0)
+		return PRI_MIN - 1;
+	return PRI_MIN + 63 - __builtin_clzll (mask);
+}
+
+/* Returns true if a thread ready on C should preempt CURR, which
+   is running on C: a deadline thread with an earlier deadline, or,
+   if CURR is not a deadline thread, any deadline thread or a
+   thread of higher priority. */
+static bool
+should_preempt (struct cpu *c, struct thread *curr) {
+	bool preempt;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (curr == c->idle_thread)
+		return false;
+
+	spinlock_acquire (&c->rq_lock);
+	if (!pq_empty (&c->dl_queue))
+		preempt = !curr->dl
+			|| pq_max (&c->dl_queue)->key > dl_key (curr->dl_deadline);
+	else
+		preempt = !curr->dl
+			&& ready_queue_max_priority (c) > curr->priority;
+	spinlock_release (&c->rq_lock);
+	return preempt;
+}
+
+/* Returns the deadline run queue key for DEADLINE.  Earlier
+   deadlines get larger keys, so they come out of the queue first.
+   Ticks fit in an int for the first 248 days of uptime. */
+static int
+dl_key (int64_t deadline) {
+	return -(int) deadline;
+}
+
+/* Returns the bandwidth that T reserves, in per mille. */
+static int
+dl_bw (const struct thread *t) {
+	return t->dl ? DIV_ROUND_UP (t->dl_runtime * 1000, t->dl_period) : 0;
+}
+
+/* Starts a new job of deadline thread T, released at tick RELEASE,
+   with a full budget. */
+static void
+dl_new_job (struct thread *t, int64_t release) {
+	t->dl_deadline = release + t->dl_rel_deadline;
+	t->dl_next = release + t->dl_period;
+	t->dl_budget = t->dl_runtime;
+}
+
+/* Called when deadline thread T wakes up.  T keeps its current
+   deadline and budget only if running out the budget before the
+   deadline would stay within its bandwidth; otherwise, notably
+   when the deadline has passed, T starts a new job. */
+static void
+dl_wakeup (struct thread *t) {
+	int64_t now = timer_ticks ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (now >= t->dl_deadline
+			|| t->dl_budget * t->dl_period
+			   > (t->dl_deadline - now) * t->dl_runtime)
+		dl_new_job (t, now);
+}
+
+/* Takes T, which must not be in a run queue, out of the deadline
+   class, if it is in it, and frees its bandwidth. */
+static void
+dl_leave (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	t->cpu->dl_bw -= dl_bw (t);
+	t->dl = false;
+	t->dl_throttled = false;
+}
+
+/* Gives every throttled deadline thread on C whose next period has
+   begun by tick NOW a new job, and makes it eligible to run. */
+static void
+dl_replenish (struct cpu *c, int64_t now) {
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&c->rq_lock);
+	for (e = list_begin (&c->dl_throttled); e != list_end (&c->dl_throttled);) {
+		struct thread *t = list_entry (e, struct thread, elem);
+
+		e = list_next (e);
+		if (t->dl_next <= now) {
+			list_remove (&t->elem);
+			t->dl_throttled = false;
+			dl_new_job (t, now);
+			pq_push (&c->dl_queue, &t->dl_elem, dl_key (t->dl_deadline));
+			c->ready_cnt++;
+		}
+	}
+	spinlock_release (&c->rq_lock);
+}
+
+/* Returns the MLFQS priority of T, computed from its recent_cpu
+   and nice values. */
+static int
+mlfqs_priority (const struct thread *t) {
+	int priority = PRI_MAX - fp_to_int (t->recent_cpu / 4) - t->nice * 2;
+
+	if (priority < PRI_MIN)
+		return PRI_MIN;
+	if (priority > PRI_MAX)
+		return PRI_MAX;
+	return priority;
+}
+
+/* Applies one second of recent_cpu decay with coefficient COEF
+   to T. */
+static void
+mlfqs_decay (struct thread *t, fixed_t coef) {
+	t->recent_cpu = fp_add_int (fp_mul (coef, t->recent_cpu), t->nice);
+}
+
+/* Brings the recent_cpu and priority of T, which has been
+   blocked, up to date with the decays it missed.  Costs one step
+   per second missed, up to a bound.  Beyond DECAY_HISTORY seconds
+   the coefficients are no longer known; the oldest one stands in
+   for them, which is accurate enough because recent_cpu has
+   converged long before then. */
+static void
+mlfqs_catch_up (struct thread *t) {
+	int64_t missed = decay_cnt - t->decay_sec;
+	int64_t sec;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (missed > DECAY_HISTORY) {
+		fixed_t coef = decay_coefs[decay_cnt % DECAY_HISTORY];
+		int64_t extra = missed - DECAY_HISTORY;
+
+		if (extra > DECAY_HISTORY)
+			extra = DECAY_HISTORY;
+		while (extra-- > 0)
+			mlfqs_decay (t, coef);
+		missed = DECAY_HISTORY;
+	}
+	for (sec = decay_cnt - missed; sec < decay_cnt; sec++)
+		mlfqs_decay (t, decay_coefs[sec % DECAY_HISTORY]);
+	t->decay_sec = decay_cnt;
+	t->priority = mlfqs_priority (t);
+}
+
+/* Once-a-second MLFQS update: recomputes load_avg, then decays
+   the recent_cpu of the running thread and of every ready thread
+   and requeues the ready threads at their new priorities.
+   Blocked threads are left for mlfqs_catch_up(). */
+static void
+mlfqs_second (void) {
+	struct thread *curr = running_thread ();
+	bool idle = curr == this_cpu ()->idle_thread;
+	int ready_cnt = idle ? 0 : 1;
+	fixed_t coef;
+	unsigned id;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (id = 0; id < cpu_cnt; id++)
+		ready_cnt += cpus[id].ready_cnt;
+	load_avg = load_avg * 59 / 60 + fp_from_int (ready_cnt) / 60;
+	coef = fp_div (load_avg * 2, fp_add_int (load_avg * 2, 1));
+	decay_coefs[decay_cnt % DECAY_HISTORY] = coef;
+	decay_cnt++;
+
+	if (!idle) {
+		mlfqs_decay (curr, coef);
+		curr->decay_sec = decay_cnt;
+		curr->priority = mlfqs_priority (curr);
+	}
+
+	for (id = 0; id < cpu_cnt; id++) {
+		struct cpu *c = &cpus[id];
+		struct list ready;
+		int pri;
+
+		/* Empty the run queue, highest priority first, so that
+		   threads keep their relative order... */
+		list_init (&ready);
+		spinlock_acquire (&c->rq_lock);
+		for (pri = PRI_MAX; pri >= PRI_MIN; pri--) {
+			struct list *queue = &c->ready_queues[pri - PRI_MIN];
+			list_splice (list_end (&ready), list_begin (queue), list_end (queue));
+		}
+		c->ready_mask = 0;
+		c->ready_cnt = pq_size (&c->dl_queue);
+		spinlock_release (&c->rq_lock);
+
+		/* ...then put each thread back at its new priority. */
+		while (!list_empty (&ready)) {
+			struct thread *t = list_entry (list_pop_front (&ready),
+					struct thread, elem);
+
+			mlfqs_decay (t, coef);
+			t->decay_sec = decay_cnt;
+			t->priority = mlfqs_priority (t);
+			ready_queue_push (t);
+		}
+	}
+}
+
+/* MLFQS work for a timer tick while T is running.  T's recent_cpu
+   grows every tick, so every fourth tick its priority is
+   recomputed.  No other thread's priority changes between the
+   once-a-second updates, so no other thread is touched. */
+static void
+mlfqs_tick (struct thread *t) {
+	struct cpu *c = this_cpu ();
+	int64_t now = timer_ticks ();
+	bool idle = t == c->idle_thread;
+
+	if (!idle)
+		t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+
+	if (now % TIMER_FREQ == 0)
+		mlfqs_second ();
+	else if (now % 4 == 0 && !idle)
+		t->priority = mlfqs_priority (t);
+	else
+		return;
+
+	if (should_preempt (c, t))
+		intr_yield_on_return ();
 }
 
 /* Use iretq to launch the thread */
@@ -609,73 +1236,33 @@ do_iret (struct intr_frame *tf) {
 			: : "g" ((uint64_t) tf) : "memory");
 }
 
-/* Switching the thread by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+/* Switches from the running thread to TH, which must already be
+   marked as running.  Only the callee-saved registers and the
+   stack pointer are saved and restored, because every switch is a
+   function call made from schedule().  Returns when the running
+   thread is next scheduled.
 
-   At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.
+   At this function's invocation, interrupts are disabled, and
+   they are still disabled when it returns, in either thread.
 
    It's not safe to call printf() until the thread switch is
    complete.  In practice that means that printf()s should be
    added at the end of the function. */
 static void
 thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
 	ASSERT (intr_get_level () == INTR_OFF);
 
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
+	switch_threads (&running_thread ()->switch_rsp, th->switch_rsp);
+}
+
+/* Where a new thread's first switch returns to.  Enters
+   kernel_thread() through the thread's intr_frame, with iretq, so
+   that it starts with a full register context and the interrupt
+   flag from that frame. */
+static void
+thread_entry (void) {
+	do_iret (&thread_current ()->tf);
+	NOT_REACHED ();
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -689,7 +1276,7 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		thread_page_put (victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
@@ -727,6 +1314,13 @@ schedule (void) {
 			list_push_back (&destruction_req, &curr->elem);
 		}
 
+		if (sched_trace_enabled)
+			sched_trace_switch (curr, next);
+
+		/* Let NEXT trap on its first FPU use unless its state
+		   is still in the FPU registers. */
+		fpu_switch (next);
+
 		/* Before switching the thread, we first save the information
 		 * of current running. */
 		thread_launch (next);
@@ -745,3 +1339,91 @@ allocate_tid (void) {
 
 	return tid;
 }
+
+/* Returns a page for a new thread, or a null pointer if memory
+   is exhausted.  The page of a thread that recently died on this
+   CPU is preferred: it is likely still in the cache, and taking
+   it does not touch the page allocator.  The page is not zeroed,
+   because init_thread() clears struct thread and the rest of the
+   page is stack. */
+static struct thread *
+thread_page_get (void) {
+	struct thread *t = NULL;
+	enum intr_level old_level = intr_disable ();
+	struct cpu *c = this_cpu ();
+
+	spinlock_acquire (&c->thread_cache_lock);
+	if (c->thread_cache_cnt > 0) {
+		t = c->thread_cache[--c->thread_cache_cnt];
+		c->thread_cache_hits++;
+	}
+	spinlock_release (&c->thread_cache_lock);
+	intr_set_level (old_level);
+
+	if (t == NULL)
+		t = palloc_get_page (0);
+	return t;
+}
+
+/* Gives back the page of thread T, which must not be running.
+   Keeps it in this CPU's thread cache unless the cache is full. */
+static void
+thread_page_put (struct thread *t) {
+	enum intr_level old_level = intr_disable ();
+	struct cpu *c = this_cpu ();
+	bool cached = false;
+
+	t->magic = 0;
+	spinlock_acquire (&c->thread_cache_lock);
+	if (c->thread_cache_cnt < THREAD_CACHE_MAX) {
+		c->thread_cache[c->thread_cache_cnt++] = t;
+		cached = true;
+	}
+	spinlock_release (&c->thread_cache_lock);
+	if (!cached)
+		palloc_free_page (t);
+	intr_set_level (old_level);
+}
+
+/* Empties every CPU's thread cache into the page allocator.
+   Registered with palloc_register_reclaim(), so that cached pages
+   are not lost to a kernel that runs low on memory.  Returns the
+   number of pages freed. */
+static size_t
+thread_cache_reclaim (void) {
+	size_t freed = 0;
+
+	for (unsigned id = 0; id < cpu_cnt; id++) {
+		struct cpu *c = &cpus[id];
+
+		for (;;) {
+			enum intr_level old_level = intr_disable ();
+			void *page = NULL;
+
+			spinlock_acquire (&c->thread_cache_lock);
+			if (c->thread_cache_cnt > 0)
+				page = c->thread_cache[--c->thread_cache_cnt];
+			spinlock_release (&c->thread_cache_lock);
+			intr_set_level (old_level);
+
+			if (page == NULL)
+				break;
+			palloc_free_page (page);
+			freed++;
+		}
+	}
+	return freed;
+}
+
+/* Records that creating a thread took CYCLES TSC cycles. */
+static void
+count_create (uint64_t cycles) {
+	enum intr_level old_level = intr_disable ();
+	struct cpu *c = this_cpu ();
+
+	c->thread_creates++;
+	c->create_cycles += cycles;
+	if (cycles > c->create_cycles_max)
+		c->create_cycles_max = cycles;
+	intr_set_level (old_level);
+}
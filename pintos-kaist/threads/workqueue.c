@@ -0,0 +1,243 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Deferred work, or "bottom halves".
+
+   An interrupt handler should do only what cannot wait, such as
+   acknowledging the device, and leave the rest to a work item
+   queued with work_queue().  Work runs with interrupts on, so it
+   does not add to the latency of other interrupts.
+
+   WORK_HIGH items run as soon as the outermost interrupt handler
+   has acknowledged the interrupt on the PIC, on the interrupted
+   thread's stack.  This is still interrupt context: intr_context()
+   is true, so they must not sleep, and a thread they wake up runs
+   when the handler returns.  At most SOFTIRQ_BUDGET items run in
+   one pass; the rest are left to the worker thread, so that a
+   burst of work cannot hold up the interrupted thread for long.
+
+   WORK_NORMAL items run in a kernel worker thread, "kworker", at
+   PRI_MAX, and may sleep.
+
+   Each CPU has its own queues, filled by work_queue() on that CPU
+   and drained there.  An item is run once however many times it
+   is queued before it starts; once it has started it may be
+   queued again, even by itself. */
+
+/* Maximum number of WORK_HIGH items run on one interrupt return. */
+#define SOFTIRQ_BUDGET 32
+
+/* Queue statistics. */
+struct work_stats {
+	long long queued;           /* # of items queued. */
+	long long ran;              /* # of items run. */
+	size_t depth;               /* # of items waiting now. */
+	size_t max_depth;           /* Largest DEPTH so far. */
+	uint64_t latency;           /* TSC cycles from queueing to running. */
+	uint64_t max_latency;       /* Largest latency of one item. */
+};
+
+/* Per-CPU work queues. */
+struct work_cpu {
+	struct spinlock lock;       /* Protects the members below. */
+	struct list queues[WORK_PRI_CNT];
+	struct work_stats stats[WORK_PRI_CNT];
+	struct semaphore worker_sema;       /* Up'd when there is work
+										   for the worker thread. */
+};
+
+static struct work_cpu work_cpus[CPU_MAX];
+
+static thread_func worker;
+static bool run_one (struct work_cpu *, enum work_priority);
+
+/* Initializes the work queues. */
+void
+workqueue_init (void) {
+	unsigned id;
+
+	for (id = 0; id < CPU_MAX; id++) {
+		struct work_cpu *wc = &work_cpus[id];
+		int pri;
+
+		spinlock_init (&wc->lock, "work queue");
+		for (pri = 0; pri < WORK_PRI_CNT; pri++)
+			list_init (&wc->queues[pri]);
+		sema_init (&wc->worker_sema, 0);
+	}
+}
+
+/* Starts the worker threads.  Until then WORK_NORMAL items only
+   pile up. */
+void
+workqueue_start (void) {
+	unsigned id;
+
+	for (id = 0; id < cpu_cnt; id++)
+		if (thread_create ("kworker", PRI_MAX, worker,
+					&work_cpus[id]) == TID_ERROR)
+			PANIC ("workqueue: cannot start worker thread");
+}
+
+/* Initializes W to call FUNC with AUX when it runs. */
+void
+work_init (struct work *w, work_func *func, void *aux) {
+	ASSERT (w != NULL);
+	ASSERT (func != NULL);
+
+	w->func = func;
+	w->aux = aux;
+	w->pending = false;
+}
+
+/* Queues W to run at priority PRI on this CPU.  Returns false,
+   doing nothing, if W is already queued and has not started yet.
+   May be called from an interrupt handler. */
+bool
+work_queue (struct work *w, enum work_priority pri) {
+	struct work_cpu *wc;
+	enum intr_level old_level;
+	bool queued = false;
+
+	ASSERT (w != NULL && w->func != NULL);
+	ASSERT (pri < WORK_PRI_CNT);
+
+	old_level = intr_disable ();
+	wc = &work_cpus[this_cpu ()->id];
+	spinlock_acquire (&wc->lock);
+	if (!w->pending) {
+		struct work_stats *s = &wc->stats[pri];
+
+		w->pending = true;
+		w->queued_at = rdtsc ();
+		list_push_back (&wc->queues[pri], &w->elem);
+		s->queued++;
+		if (++s->depth > s->max_depth)
+			s->max_depth = s->depth;
+		queued = true;
+	}
+	spinlock_release (&wc->lock);
+
+	/* Outside an interrupt handler nothing would run a WORK_HIGH
+	   item before the next interrupt, so let the worker do it. */
+	if (queued && (pri == WORK_NORMAL || !intr_context ()))
+		sema_up (&wc->worker_sema);
+	intr_set_level (old_level);
+	return queued;
+}
+
+/* Returns true if WORK_HIGH items are waiting on this CPU.  The
+   answer may be stale unless interrupts are off. */
+bool
+workqueue_softirq_pending (void) {
+	return !list_empty (&work_cpus[this_cpu ()->id].queues[WORK_HIGH]);
+}
+
+/* Runs this CPU's WORK_HIGH items.  Called by intr_handler() at
+   the end of an external interrupt, with interrupts off. */
+void
+workqueue_softirq (void) {
+	struct work_cpu *wc = &work_cpus[this_cpu ()->id];
+	int budget = SOFTIRQ_BUDGET;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (intr_context ());
+
+	while (budget-- > 0 && run_one (wc, WORK_HIGH))
+		continue;
+	if (workqueue_softirq_pending ())
+		sema_up (&wc->worker_sema);
+}
+
+/* Prints work queue statistics. */
+void
+workqueue_print_stats (void) {
+	static const char *names[WORK_PRI_CNT] = { "high", "normal" };
+	int pri;
+
+	for (pri = 0; pri < WORK_PRI_CNT; pri++) {
+		struct work_stats total = { 0 };
+		unsigned id;
+
+		for (id = 0; id < cpu_cnt; id++) {
+			const struct work_stats *s = &work_cpus[id].stats[pri];
+
+			total.queued += s->queued;
+			total.ran += s->ran;
+			total.depth += s->depth;
+			if (s->max_depth > total.max_depth)
+				total.max_depth = s->max_depth;
+			total.latency += s->latency;
+			if (s->max_latency > total.max_latency)
+				total.max_latency = s->max_latency;
+		}
+		if (total.queued == 0)
+			continue;
+		printf ("Work %s: %lld queued, %lld run, depth %zu (max %zu), "
+				"latency %llu cycles avg, %llu max\n", names[pri],
+				total.queued, total.ran, total.depth, total.max_depth,
+				total.ran > 0 ? total.latency / total.ran : 0,
+				total.max_latency);
+	}
+}
+
+/* Worker thread: runs the work queued on CPU WC_, high priority
+   first. */
+static void
+worker (void *wc_) {
+	struct work_cpu *wc = wc_;
+
+	for (;;) {
+		sema_down (&wc->worker_sema);
+
+		intr_disable ();
+		while (run_one (wc, WORK_HIGH) || run_one (wc, WORK_NORMAL))
+			continue;
+		intr_enable ();
+	}
+}
+
+/* Takes the oldest item of priority PRI off WC's queue and runs
+   it with interrupts on.  Returns false if there was none.
+   Interrupts must be off, and are off again on return. */
+static bool
+run_one (struct work_cpu *wc, enum work_priority pri) {
+	struct work_stats *s = &wc->stats[pri];
+	struct work *w = NULL;
+	work_func *func;
+	void *aux;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&wc->lock);
+	if (!list_empty (&wc->queues[pri])) {
+		uint64_t latency;
+
+		w = list_entry (list_pop_front (&wc->queues[pri]), struct work, elem);
+		w->pending = false;
+		latency = rdtsc () - w->queued_at;
+		s->depth--;
+		s->ran++;
+		s->latency += latency;
+		if (latency > s->max_latency)
+			s->max_latency = latency;
+	}
+	spinlock_release (&wc->lock);
+	if (w == NULL)
+		return false;
+
+	/* W may be queued again, or freed, once it is no longer
+	   pending. */
+	func = w->func;
+	aux = w->aux;
+	intr_enable ();
+	func (aux);
+	intr_disable ();
+	return true;
+}
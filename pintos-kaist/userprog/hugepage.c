@@ -0,0 +1,177 @@
+#include "userprog/hugepage.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/io-ring.h"
+
+/* Transparent large pages for user memory, after Linux's
+   khugepaged.
+
+   With -largepages, a kernel thread wakes up every SCAN_TICKS
+   ticks and looks through the address space of every process
+   for 2 MB regions that are mapped entirely with 4 kB pages.  It
+   promotes those whose frames already happen to be contiguous
+   and copies the rest into new contiguous frames with
+   pml4_collapse(), trying at most SCAN_MAX regions per pass, so
+   that memory mapped a page at a time still ends up in large
+   pages.
+
+   The kernel must not use a region's old frames while it is
+   being copied.  The collapser holds the process's group_lock,
+   under which its thread stacks are mapped and unmapped and its
+   page table is duplicated by fork(), and it skips the pages of
+   the process's I/O ring, which the kernel writes through their
+   kernel addresses.  Without VM the page table owns the frames,
+   so pml4_collapse() just frees the old ones.  A VM would have to
+   hear about it, so under VM the collapser does not run. */
+
+#define SCAN_TICKS 100                  /* Ticks between passes. */
+#define SCAN_MAX 8                      /* Regions tried per pass. */
+
+/* A process whose address space is scanned. */
+struct space {
+	struct list_elem elem;              /* Element in spaces. */
+	struct thread *leader;              /* Process's main thread. */
+};
+
+static struct list spaces;              /* Registered processes. */
+static struct lock spaces_lock;         /* Held for a whole pass. */
+static bool running;                    /* Collapser started? */
+
+/* Statistics. */
+static long long scan_cnt;              /* Passes. */
+static long long promote_cnt;           /* Regions promoted in place. */
+static long long collapse_cnt;          /* Regions copied and mapped. */
+static long long fail_cnt;              /* Regions that changed meanwhile. */
+
+#ifndef VM
+static thread_func collapser;
+#endif
+
+/* Starts the collapser if -largepages was given. */
+void
+hugepage_init (void) {
+	list_init (&spaces);
+	lock_init (&spaces_lock);
+#ifndef VM
+	if (large_user_pages
+			&& thread_create ("khugepaged", PRI_DEFAULT, collapser, NULL)
+				!= TID_ERROR)
+		running = true;
+#endif
+}
+
+/* Has the collapser scan the address space of LEADER's process
+   from now on.  If memory runs out, it just won't. */
+void
+hugepage_register (struct thread *leader) {
+	struct space *s;
+
+	if (!running)
+		return;
+	s = malloc (sizeof *s);
+	if (s == NULL)
+		return;
+	s->leader = leader;
+	lock_acquire (&spaces_lock);
+	list_push_back (&spaces, &s->elem);
+	lock_release (&spaces_lock);
+}
+
+/* Stops the collapser from scanning the address space of
+   LEADER's process, waiting for a pass in progress to finish.
+   Must be called before the address space is destroyed. */
+void
+hugepage_unregister (struct thread *leader) {
+	struct list_elem *e;
+
+	if (!running)
+		return;
+	lock_acquire (&spaces_lock);
+	for (e = list_begin (&spaces); e != list_end (&spaces); e = list_next (e)) {
+		struct space *s = list_entry (e, struct space, elem);
+
+		if (s->leader == leader) {
+			list_remove (e);
+			free (s);
+			break;
+		}
+	}
+	lock_release (&spaces_lock);
+}
+
+/* Prints collapser statistics. */
+void
+hugepage_print_stats (void) {
+	if (running)
+		printf ("Khugepaged: %lld passes, %lld regions promoted, "
+				"%lld collapsed, %lld failed\n",
+				scan_cnt, promote_cnt, collapse_cnt, fail_cnt);
+}
+
+#ifndef VM
+/* Returns true if any page of the 2 MB region at VA belongs to
+   LEADER's I/O ring. */
+static bool
+maps_io_ring (struct thread *leader, uint64_t va) {
+	size_t i;
+
+	for (i = 0; i < LARGE_PGCNT; i++)
+		if (io_ring_maps (leader, (void *) (va + i * PGSIZE)))
+			return true;
+	return false;
+}
+
+/* Tries to turn at most BUDGET regions of LEADER's address space
+   into large pages.  Returns the number of regions tried. */
+static int
+scan_space (struct thread *leader, int budget) {
+	uint64_t va = 0;
+	int tried = 0;
+
+	while (tried < budget && leader->pml4 != NULL
+			&& pml4_next_collapsible (leader->pml4, &va)) {
+		if (!maps_io_ring (leader, va)) {
+			if (pml4_promote (leader->pml4, (void *) va))
+				promote_cnt++;
+			else if (pml4_collapse (leader->pml4, (void *) va))
+				collapse_cnt++;
+			else
+				fail_cnt++;
+			tried++;
+		}
+		va += LARGE_PGSIZE;
+	}
+	return tried;
+}
+
+/* The collapser thread. */
+static void
+collapser (void *aux UNUSED) {
+	for (;;) {
+		struct list_elem *e;
+		int budget = SCAN_MAX;
+
+		timer_sleep (SCAN_TICKS);
+
+		lock_acquire (&spaces_lock);
+		scan_cnt++;
+		for (e = list_begin (&spaces); e != list_end (&spaces) && budget > 0;
+				e = list_next (e)) {
+			struct thread *leader = list_entry (e, struct space, elem)->leader;
+
+			/* A busy process is left for the next pass. */
+			if (!lock_try_acquire (&leader->group_lock))
+				continue;
+			budget -= scan_space (leader, budget);
+			lock_release (&leader->group_lock);
+		}
+		lock_release (&spaces_lock);
+	}
+}
+#endif
@@ -0,0 +1,430 @@
+#include "userprog/io-ring.h"
+#include <debug.h>
+#include <io-ring.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+
+/* Asynchronous system call rings; see lib/io-ring.h for the
+   layout shared with the process.
+
+   A process has at most one ring, hung off its main thread and
+   mapped at RING_BASE, below the stacks of its other threads.
+   The kernel reaches the ring through its own mapping of the
+   pages, and the buffers named in SQEs through the process's
+   page table: io_ring_enter() runs in the process already, and
+   the SQPOLL thread borrows the page table for as long as it
+   lives. */
+
+/* User address of the ring mapping. */
+#define RING_BASE ((uint8_t *) USER_STACK - 4 * 1024 * 1024)
+
+/* Ticks the SQPOLL thread keeps polling an empty ring before it
+   sets IO_RING_NEED_WAKEUP and goes to sleep. */
+#define POLL_IDLE_TICKS 2
+
+/* Longest file name IO_RING_OPEN accepts, including the null. */
+#define NAME_MAX_LEN 128
+
+/* A process's ring. */
+struct io_ring_ctx {
+	struct io_ring *ring;           /* Kernel mapping of the ring. */
+	struct io_sqe *sqes;            /* Its SQEs. */
+	struct io_cqe *cqes;            /* Its CQEs. */
+	size_t pages;                   /* Pages in the mapping. */
+	uint32_t sq_entries;            /* Trusted copies of the sizes... */
+	uint32_t cq_entries;
+	uint32_t sq_head;               /* ...and of the kernel's counters. */
+	uint32_t cq_tail;
+
+	struct thread *leader;          /* Main thread of the process. */
+	uint64_t *pml4;                 /* Process page table. */
+
+	struct lock lock;               /* One consumer of the SQ at a time. */
+	struct condition completed;     /* CQEs were posted. */
+
+	/* IO_RING_SQPOLL only. */
+	struct thread *poller;          /* Polling thread. */
+	struct semaphore started;       /* Upped once the poller runs. */
+	struct semaphore wake;          /* Wakes a sleeping poller. */
+	bool stop;                      /* Tells the poller to exit. */
+};
+
+/* Reads *P once, without letting the compiler cache it. */
+static inline uint32_t
+load (const uint32_t *p) {
+	return *(const volatile uint32_t *) p;
+}
+
+/* Publishes V in *P after every store before it. */
+static inline void
+store (uint32_t *p, uint32_t v) {
+	barrier ();
+	*(volatile uint32_t *) p = v;
+}
+
+/* Returns true if the LEN bytes at user address UADDR are mapped
+   in CTX's process, and writable too if WRITABLE is true. */
+static bool
+user_range_ok (struct io_ring_ctx *ctx, uint64_t uaddr, size_t len,
+		bool writable) {
+	uint64_t page;
+
+	if (len == 0)
+		return true;
+	if (uaddr + len < uaddr || !is_user_vaddr (uaddr + len - 1))
+		return false;
+	for (page = (uint64_t) pg_round_down (uaddr); page < uaddr + len; page += PGSIZE) {
+		uint64_t *pte = pml4e_walk (ctx->pml4, page, 0);
+
+		if (pte == NULL || (*pte & PTE_P) == 0 || !is_user_pte (pte)
+				|| (writable && !is_writable (pte)))
+			return false;
+	}
+	return true;
+}
+
+/* Returns the file open as FD in CTX's process, or a null
+   pointer. */
+static struct file *
+lookup_file (struct io_ring_ctx *ctx, int fd) {
+	if (fd < 2 || fd >= FDCOUNT_LIMIT)
+		return NULL;
+	return ctx->leader->fdt[fd];
+}
+
+static int
+do_read (struct io_ring_ctx *ctx, const struct io_sqe *sqe) {
+	void *buffer = (void *) sqe->addr;
+	struct file *file;
+	int n;
+
+	if (!user_range_ok (ctx, sqe->addr, sqe->len, true))
+		return -1;
+
+	/* Reads at an offset leave the file position alone and may run
+	   together; others advance it and must run alone. */
+	if (sqe->off >= 0) {
+		struct rw_hold hold;
+
+		rwlock_acquire_read (&filesys_lock, &hold);
+		file = lookup_file (ctx, sqe->fd);
+		n = file != NULL ? file_read_at (file, buffer, sqe->len, sqe->off) : -1;
+		rwlock_release_read (&filesys_lock, &hold);
+	} else {
+		rwlock_acquire_write (&filesys_lock);
+		file = lookup_file (ctx, sqe->fd);
+		n = file != NULL ? file_read (file, buffer, sqe->len) : -1;
+		rwlock_release_write (&filesys_lock);
+	}
+	return n;
+}
+
+static int
+do_write (struct io_ring_ctx *ctx, const struct io_sqe *sqe) {
+	const void *buffer = (const void *) sqe->addr;
+	struct file *file;
+	int n;
+
+	if (!user_range_ok (ctx, sqe->addr, sqe->len, false))
+		return -1;
+	if (sqe->fd == 1) {
+		putbuf (buffer, sqe->len);
+		return sqe->len;
+	}
+
+	rwlock_acquire_write (&filesys_lock);
+	file = lookup_file (ctx, sqe->fd);
+	if (file == NULL)
+		n = -1;
+	else if (sqe->off >= 0)
+		n = file_write_at (file, buffer, sqe->len, sqe->off);
+	else
+		n = file_write (file, buffer, sqe->len);
+	rwlock_release_write (&filesys_lock);
+	return n;
+}
+
+static int
+do_open (struct io_ring_ctx *ctx, const struct io_sqe *sqe) {
+	char name[NAME_MAX_LEN];
+	struct rw_hold hold;
+	struct file *file;
+	int fd;
+	size_t i;
+
+	/* Copy in the name, checking each page it touches. */
+	for (i = 0; i < sizeof name; i++) {
+		uint64_t uaddr = sqe->addr + i;
+
+		if ((i == 0 || uaddr % PGSIZE == 0)
+				&& !user_range_ok (ctx, uaddr, 1, false))
+			return -1;
+		name[i] = *(const char *) uaddr;
+		if (name[i] == '\0')
+			break;
+	}
+	if (i == 0 || i == sizeof name)
+		return -1;
+
+	rwlock_acquire_read (&filesys_lock, &hold);
+	file = filesys_open (name);
+	fd = file != NULL ? add_file_to (ctx->leader, file) : -1;
+	if (file != NULL && fd == -1)
+		file_close (file);
+	rwlock_release_read (&filesys_lock, &hold);
+	return fd;
+}
+
+static int
+do_close (struct io_ring_ctx *ctx, const struct io_sqe *sqe) {
+	struct file *file;
+
+	rwlock_acquire_write (&filesys_lock);
+	file = lookup_file (ctx, sqe->fd);
+	if (file != NULL) {
+		file_close (file);
+		ctx->leader->fdt[sqe->fd] = NULL;
+	}
+	rwlock_release_write (&filesys_lock);
+	return file != NULL ? 0 : -1;
+}
+
+/* Carries out SQE and returns its result. */
+static int
+run (struct io_ring_ctx *ctx, const struct io_sqe *sqe) {
+	switch (sqe->op) {
+		case IO_RING_NOP:
+			return 0;
+		case IO_RING_READ:
+			return do_read (ctx, sqe);
+		case IO_RING_WRITE:
+			return do_write (ctx, sqe);
+		case IO_RING_OPEN:
+			return do_open (ctx, sqe);
+		case IO_RING_CLOSE:
+			return do_close (ctx, sqe);
+		default:
+			return -1;
+	}
+}
+
+/* Consumes up to MAX published SQEs of CTX, carrying out each and
+   posting its CQE.  Stops early when the CQ is full, so that no
+   completion is ever lost.  Returns the number consumed. */
+static unsigned
+consume (struct io_ring_ctx *ctx, unsigned max) {
+	struct io_ring *ring = ctx->ring;
+	unsigned n = 0;
+
+	lock_acquire (&ctx->lock);
+	while (n < max && ctx->sq_head != load (&ring->sq_tail)
+			&& ctx->cq_tail - load (&ring->cq_head) < ctx->cq_entries) {
+		struct io_sqe sqe;
+		struct io_cqe *cqe;
+
+		/* Work from a copy the process cannot change under us. */
+		barrier ();
+		sqe = ctx->sqes[ctx->sq_head & (ctx->sq_entries - 1)];
+		store (&ring->sq_head, ++ctx->sq_head);
+
+		cqe = &ctx->cqes[ctx->cq_tail & (ctx->cq_entries - 1)];
+		cqe->user_data = sqe.user_data;
+		cqe->res = run (ctx, &sqe);
+		store (&ring->cq_tail, ++ctx->cq_tail);
+		n++;
+	}
+	if (n > 0)
+		cond_broadcast (&ctx->completed, &ctx->lock);
+	lock_release (&ctx->lock);
+	return n;
+}
+
+/* The SQPOLL thread: consumes SQEs as the process publishes them,
+   and sleeps once the ring has been idle a while. */
+static void
+poll_ring (void *ctx_) {
+	struct io_ring_ctx *ctx = ctx_;
+	struct thread *cur = thread_current ();
+	int64_t idle_since = timer_ticks ();
+
+	/* Borrow the process's page table to reach its buffers. */
+	cur->pml4 = ctx->pml4;
+	process_activate (cur);
+	ctx->poller = cur;
+	sema_up (&ctx->started);
+
+	while (!ctx->stop) {
+		if (consume (ctx, UINT32_MAX) > 0) {
+			idle_since = timer_ticks ();
+			continue;
+		}
+		if (timer_elapsed (idle_since) < POLL_IDLE_TICKS) {
+			thread_yield ();
+			continue;
+		}
+
+		/* Advertise the nap, then take one last look: a process
+		   that publishes SQEs checks the flag afterward, so
+		   either it sees the flag or we see its SQEs. */
+		store (&ctx->ring->flags, IO_RING_NEED_WAKEUP);
+		asm volatile ("mfence" : : : "memory");
+		if (ctx->sq_head == load (&ctx->ring->sq_tail))
+			sema_down (&ctx->wake);
+		store (&ctx->ring->flags, 0);
+		idle_since = timer_ticks ();
+	}
+
+	cur->pml4 = NULL;
+	pml4_activate (NULL);
+}
+
+/* Maps a ring with ENTRIES SQEs into the running process, which
+   must not have one yet.  With IO_RING_SQPOLL in FLAGS, also
+   starts a kernel thread that polls it.  Returns the ring's user
+   address, or a null pointer on failure. */
+void *
+io_ring_setup (unsigned entries, unsigned flags) {
+	struct thread *leader = thread_current ()->leader;
+	struct io_ring_ctx *ctx;
+	size_t i;
+
+	if (entries == 0 || entries > IO_RING_MAX_ENTRIES
+			|| (entries & (entries - 1)) != 0
+			|| (flags & ~IO_RING_SQPOLL) != 0 || leader->pml4 == NULL)
+		return NULL;
+
+	ctx = calloc (1, sizeof *ctx);
+	if (ctx == NULL)
+		return NULL;
+	ctx->pages = DIV_ROUND_UP (io_ring_size (entries), PGSIZE);
+	ctx->ring = palloc_get_multiple (PAL_USER | PAL_ZERO, ctx->pages);
+	if (ctx->ring == NULL) {
+		free (ctx);
+		return NULL;
+	}
+	ctx->sq_entries = entries;
+	ctx->cq_entries = 2 * entries;
+	ctx->sqes = io_ring_sqes (ctx->ring);
+	ctx->cqes = io_ring_cqes (ctx->ring, entries);
+	ctx->leader = leader;
+	ctx->pml4 = leader->pml4;
+	lock_init (&ctx->lock);
+	cond_init (&ctx->completed);
+	sema_init (&ctx->started, 0);
+	sema_init (&ctx->wake, 0);
+
+	ctx->ring->sq_entries = ctx->sq_entries;
+	ctx->ring->cq_entries = ctx->cq_entries;
+	ctx->ring->setup_flags = flags;
+
+	lock_acquire (&leader->group_lock);
+	if (leader->io_ring != NULL)
+		goto fail;
+	for (i = 0; i < ctx->pages; i++) {
+		uint8_t *upage = RING_BASE + i * PGSIZE;
+		uint8_t *kpage = (uint8_t *) ctx->ring + i * PGSIZE;
+
+		if (pml4_get_page (ctx->pml4, upage) != NULL
+				|| !pml4_set_page (ctx->pml4, upage, kpage, true)) {
+			while (i-- > 0)
+				pml4_clear_page (ctx->pml4, RING_BASE + i * PGSIZE);
+			goto fail;
+		}
+	}
+	leader->io_ring = ctx;
+	lock_release (&leader->group_lock);
+
+	if (flags & IO_RING_SQPOLL) {
+		tid_t tid = thread_create ("io-ring-poll", PRI_DEFAULT, poll_ring, ctx);
+
+		if (tid == TID_ERROR) {
+			io_ring_destroy (leader);
+			return NULL;
+		}
+		/* Reaped by io_ring_destroy(), not waited for. */
+		sema_down (&ctx->started);
+		list_remove (&ctx->poller->child_elem);
+	}
+	return RING_BASE;
+
+fail:
+	lock_release (&leader->group_lock);
+	palloc_free_multiple (ctx->ring, ctx->pages);
+	free (ctx);
+	return NULL;
+}
+
+/* Hands up to TO_SUBMIT published SQEs of the running process's
+   ring to the kernel.  Without a poller they are carried out
+   before returning; with one, a sleeping poller is woken and the
+   call then waits until at least MIN_COMPLETE CQEs are ready to
+   be reaped.  Returns the number of SQEs consumed, or handed to
+   the poller, or -1 if the process has no ring. */
+int
+io_ring_enter (unsigned to_submit, unsigned min_complete) {
+	struct io_ring_ctx *ctx = thread_current ()->leader->io_ring;
+	struct io_ring *ring;
+
+	if (ctx == NULL)
+		return -1;
+	ring = ctx->ring;
+
+	if (ctx->poller == NULL)
+		return consume (ctx, to_submit);
+
+	if (load (&ring->flags) & IO_RING_NEED_WAKEUP)
+		sema_up (&ctx->wake);
+	if (min_complete > ctx->cq_entries)
+		min_complete = ctx->cq_entries;
+	lock_acquire (&ctx->lock);
+	while (ctx->cq_tail - load (&ring->cq_head) < min_complete)
+		cond_wait (&ctx->completed, &ctx->lock);
+	lock_release (&ctx->lock);
+	return to_submit;
+}
+
+/* Stops LEADER's SQPOLL thread, if any, and unmaps and frees its
+   process's ring, if any.  Called as the process exits or execs,
+   once no other thread is left to use the ring. */
+void
+io_ring_destroy (struct thread *leader) {
+	struct io_ring_ctx *ctx = leader->io_ring;
+	size_t i;
+
+	if (ctx == NULL)
+		return;
+	leader->io_ring = NULL;
+
+	if (ctx->poller != NULL) {
+		ctx->stop = true;
+		sema_up (&ctx->wake);
+		sema_down (&ctx->poller->exit_sema);
+		sema_up (&ctx->poller->free_sema);
+	}
+
+	for (i = 0; i < ctx->pages; i++)
+		pml4_clear_page (ctx->pml4, RING_BASE + i * PGSIZE);
+	palloc_free_multiple (ctx->ring, ctx->pages);
+	free (ctx);
+}
+
+/* Returns true if UPAGE lies in the ring mapping of LEADER's
+   process.  fork() leaves the ring out of the child. */
+bool
+io_ring_maps (struct thread *leader, const void *upage) {
+	struct io_ring_ctx *ctx = leader->io_ring;
+
+	return ctx != NULL && (const uint8_t *) upage >= RING_BASE
+		&& (const uint8_t *) upage < RING_BASE + ctx->pages * PGSIZE;
+}
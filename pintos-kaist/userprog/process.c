@@ -11,12 +11,16 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
+#include "threads/futex.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
+#include "userprog/hugepage.h"
+#include "userprog/io-ring.h"
 #include "intrinsic.h"
 #ifdef VM
 #include "vm/vm.h"
@@ -24,10 +28,25 @@
 
 #define MAX_ARGS 14
 
+/* User stacks of the threads other than the main thread.  The
+ * stack of slot N (1 <= N <= UTHREAD_MAX) ends N spans below
+ * USER_STACK; only its top UTHREAD_STACK_PAGES pages are mapped,
+ * so the rest of the span is an unmapped guard gap. */
+#define UTHREAD_MAX 16
+#define UTHREAD_STACK_SPAN (16 * PGSIZE)
+#define UTHREAD_STACK_PAGES 2
+
+/* What process_fork() passes to __do_fork(). */
+struct fork_args {
+	struct thread *parent;              /* Forking thread. */
+	struct intr_frame *if_;             /* Its user context. */
+};
+
 static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static bool release_group (struct thread *leader);
 
 void push_args(char **argv, int argc, struct intr_frame *if_);
 struct thread* get_child_process(child_tid);
@@ -82,13 +101,13 @@ initd (void *f_name) {
 /* Clones the current process as `name`. Returns the new process's thread id, or
  * TID_ERROR if the thread cannot be created. */
 tid_t
-process_fork (const char *name, struct intr_frame *if_ UNUSED) {
-	/* Clone current thread to new thread.*/
-	struct thread* parent = thread_current();
-	memcpy(&parent->pf, if_, sizeof(struct intr_frame));
-	
+process_fork (const char *name, struct intr_frame *if_) {
+	/* Clone current thread to new thread.  The child reads ARGS,
+	 * which stay valid while we wait for it below. */
+	struct fork_args args = { thread_current (), if_ };
+
 	tid_t tid;
-	tid = thread_create (name, PRI_DEFAULT, __do_fork, parent);
+	tid = thread_create (name, PRI_DEFAULT, __do_fork, &args);
 	if (tid < 0){
 		return TID_ERROR;
 	}
@@ -118,6 +137,9 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	if (is_kernel_vaddr(va)){
 		return true;
 	}
+	/* The child does not inherit the parent's io_ring. */
+	if (io_ring_maps (parent->leader, va))
+		return true;
 	/* 2. Resolve VA from the parent's page map level 4. */
 	parent_page = pml4_get_page (parent->pml4, va);
 
@@ -155,10 +177,10 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 static void
 __do_fork (void *aux) {
 	struct intr_frame if_;
-	struct thread *parent = (struct thread *) aux; // parent thread
+	struct fork_args *args = aux;
+	struct thread *parent = args->parent; // parent thread
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if = &parent->pf;
+	struct intr_frame *parent_if = args->if_;
 	bool succ = true;
 
 	/* 1. Read the cpu context to local stack. */
@@ -177,8 +199,13 @@ __do_fork (void *aux) {
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
 		goto error;
 #else
-	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
+	/* Keep the collapser from moving the parent's pages meanwhile. */
+	lock_acquire (&parent->leader->group_lock);
+	succ = pml4_for_each (parent->pml4, duplicate_pte, parent);
+	lock_release (&parent->leader->group_lock);
+	if (!succ)
 		goto error;
+	hugepage_register (current);
 #endif
 	/* TODO: Your code goes here.
 	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
@@ -186,7 +213,7 @@ __do_fork (void *aux) {
 	 * TODO:       from the fork() until this function successfully duplicates
 	 * TODO:       the resources of parent.*/
 
-	if(parent->next_fd == FDCOUNT_LIMIT)
+	if(parent->leader->next_fd == FDCOUNT_LIMIT)
 		goto error;
 
 	for(int i=0; i < FDCOUNT_LIMIT; i++){
@@ -195,7 +222,10 @@ __do_fork (void *aux) {
 		}
 	}
 
-	current->next_fd = parent->next_fd;
+	current->next_fd = parent->leader->next_fd;
+
+	if (!fpu_fork (current, parent))
+		goto error;
 	// current->running_file = file_duplicate(parent->running_file);
 	process_init ();
 
@@ -215,7 +245,13 @@ error:
 /* Switch the current execution context to the f_name.
  * Returns -1 on fail. */
 int
-process_exec (void *f_name) {		
+process_exec (const void *f_name) {		
+	/* The other threads run in the address space we replace. */
+	if (thread_current ()->leader != thread_current ()
+			|| !release_group (thread_current ()))
+		return -1;
+	io_ring_destroy (thread_current ());
+
 	// char *file_name = f_name;
 	char *file_name = palloc_get_page (PAL_USER); // allocate pages from kernel memory pool
 	strlcpy(file_name, f_name, PGSIZE);
@@ -231,6 +267,7 @@ process_exec (void *f_name) {
 
 	/* We first kill the current context */
 	process_cleanup ();	
+	fpu_release (thread_current ());
 
 	char *token, *saveptr;
 	char *argv[128];
@@ -361,10 +398,306 @@ process_wait (tid_t child_tid UNUSED) {
 	
 }
 
+/* Returns the top of the user stack of stack slot SLOT. */
+static uint8_t *
+stack_top (int slot) {
+	return (uint8_t *) USER_STACK - slot * UTHREAD_STACK_SPAN;
+}
+
+/* Unmaps and frees whatever is mapped of the stack of SLOT in
+ * LEADER's address space. */
+static void
+unmap_thread_stack (struct thread *leader, int slot) {
+	for (int i = 1; i <= UTHREAD_STACK_PAGES; i++) {
+		uint8_t *upage = stack_top (slot) - i * PGSIZE;
+		void *kpage = pml4_get_page (leader->pml4, upage);
+
+		if (kpage != NULL) {
+			pml4_clear_page (leader->pml4, upage);
+			palloc_free_page (kpage);
+		}
+	}
+}
+
+/* Maps zeroed pages for the stack of SLOT in LEADER's address
+ * space.  Returns true if successful, false on failure. */
+static bool
+map_thread_stack (struct thread *leader, int slot) {
+	for (int i = 1; i <= UTHREAD_STACK_PAGES; i++) {
+		uint8_t *upage = stack_top (slot) - i * PGSIZE;
+		void *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+
+		if (kpage == NULL || !pml4_set_page (leader->pml4, upage, kpage, true)) {
+			if (kpage != NULL)
+				palloc_free_page (kpage);
+			unmap_thread_stack (leader, slot);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Passed from process_thread_create() to start_thread(). */
+struct thread_start {
+	struct intr_frame if_;          /* User context to start in. */
+	struct thread *leader;          /* Main thread of the process. */
+	int slot;                       /* Stack slot. */
+	struct thread *thread;          /* The new thread, once started. */
+	struct semaphore started;       /* Upped by the new thread. */
+};
+
+/* A thread function that joins the process of the thread that
+ * called process_thread_create() and drops into user mode. */
+static void
+start_thread (void *aux) {
+	struct thread_start *start = aux;
+	struct thread *current = thread_current ();
+	struct thread *leader = start->leader;
+	struct intr_frame if_;
+
+	memcpy (&if_, &start->if_, sizeof if_);
+
+	/* Share the process's descriptor table instead of the one
+	 * thread_create() gave us, and its address space. */
+	palloc_free_multiple (current->fdt, FDT_PAGES);
+	current->fdt = leader->fdt;
+	current->pml4 = leader->pml4;
+	current->leader = leader;
+	current->stack_slot = start->slot;
+	process_activate (current);
+
+	lock_acquire (&leader->group_lock);
+	list_push_back (&leader->group, &current->group_elem);
+	leader->group_live++;
+	lock_release (&leader->group_lock);
+
+	start->thread = current;
+	sema_up (&start->started);
+
+	process_check_killed ();
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
+/* Starts a new thread in the running thread's process, sharing
+ * its address space and file descriptors, on a stack of its own.
+ * The thread enters user mode at ENTRY with ARG0 and ARG1 as its
+ * first two arguments and otherwise the user context in IF_.
+ * Returns the new thread's tid, or TID_ERROR if no thread could
+ * be created. */
+tid_t
+process_thread_create (struct intr_frame *if_, void *entry,
+		void *arg0, void *arg1) {
+	struct thread *leader = thread_current ()->leader;
+	struct thread_start start;
+	tid_t tid;
+	int slot;
+
+	if (leader->pml4 == NULL || !is_user_vaddr (entry))
+		return TID_ERROR;
+
+	lock_acquire (&leader->group_lock);
+	for (slot = 1; slot <= UTHREAD_MAX; slot++)
+		if ((leader->stack_slots & (1u << slot)) == 0)
+			break;
+	if (slot > UTHREAD_MAX || !map_thread_stack (leader, slot)) {
+		lock_release (&leader->group_lock);
+		return TID_ERROR;
+	}
+	leader->stack_slots |= 1u << slot;
+	lock_release (&leader->group_lock);
+
+	/* The stack is zeroed, so the thread function finds a null
+	 * return address, aligned as on entry to any function. */
+	memcpy (&start.if_, if_, sizeof start.if_);
+	start.if_.rip = (uintptr_t) entry;
+	start.if_.R.rdi = (uint64_t) arg0;
+	start.if_.R.rsi = (uint64_t) arg1;
+	start.if_.rsp = (uintptr_t) (stack_top (slot) - sizeof (void *));
+	start.leader = leader;
+	start.slot = slot;
+	sema_init (&start.started, 0);
+
+	tid = thread_create (leader->name, PRI_DEFAULT, start_thread, &start);
+	if (tid == TID_ERROR) {
+		lock_acquire (&leader->group_lock);
+		unmap_thread_stack (leader, slot);
+		leader->stack_slots &= ~(1u << slot);
+		lock_release (&leader->group_lock);
+		return TID_ERROR;
+	}
+	sema_down (&start.started);
+
+	/* Threads are joined with process_thread_join(), not waited
+	 * for like child processes. */
+	list_remove (&start.thread->child_elem);
+	return tid;
+}
+
+/* Waits for thread TID of the running thread's process to exit,
+ * frees its stack, and returns the status it passed to
+ * process_thread_exit().  Returns -1 at once if TID is not
+ * another thread of this process or has already been joined, and
+ * -1 without joining it if the process is killed meanwhile. */
+int
+process_thread_join (tid_t tid) {
+	struct thread *cur = thread_current ();
+	struct thread *leader = cur->leader;
+	struct thread *t = NULL;
+	struct list_elem *e;
+	int status;
+
+	lock_acquire (&leader->group_lock);
+	for (e = list_begin (&leader->group); e != list_end (&leader->group);
+			e = list_next (e)) {
+		struct thread *u = list_entry (e, struct thread, group_elem);
+		if (u->tid == tid && u != cur) {
+			t = u;
+			list_remove (e);
+			break;
+		}
+	}
+	if (t == NULL) {
+		lock_release (&leader->group_lock);
+		return -1;
+	}
+
+	/* leave_group() broadcasts group_cond after upping exit_sema,
+	 * and so does process_kill() after setting killed. */
+	while (!sema_try_down (&t->exit_sema)) {
+		if (leader->killed) {
+			list_push_back (&leader->group, &t->group_elem);
+			lock_release (&leader->group_lock);
+			return -1;
+		}
+		cond_wait (&leader->group_cond, &leader->group_lock);
+	}
+	status = t->exit_status;
+	unmap_thread_stack (leader, t->stack_slot);
+	leader->stack_slots &= ~(1u << t->stack_slot);
+	lock_release (&leader->group_lock);
+
+	sema_up (&t->free_sema);
+	return status;
+}
+
+/* Waits until no thread of LEADER's process but LEADER itself is
+ * running. */
+static void
+wait_group (struct thread *leader) {
+	lock_acquire (&leader->group_lock);
+	while (leader->group_live > 0)
+		cond_wait (&leader->group_cond, &leader->group_lock);
+	lock_release (&leader->group_lock);
+}
+
+/* If no thread of LEADER's process but LEADER itself is running,
+ * lets go of the exited threads that nobody joined and returns
+ * true.  Otherwise returns false.  Their stacks go with the
+ * address space. */
+static bool
+release_group (struct thread *leader) {
+	bool idle;
+
+	lock_acquire (&leader->group_lock);
+	idle = leader->group_live == 0;
+	if (idle) {
+		while (!list_empty (&leader->group)) {
+			struct list_elem *e = list_pop_front (&leader->group);
+			sema_up (&list_entry (e, struct thread, group_elem)->free_sema);
+		}
+		leader->stack_slots = 0;
+	}
+	lock_release (&leader->group_lock);
+	return idle;
+}
+
+/* Ends the running thread with STATUS, which process_thread_join()
+ * returns.  In the main thread, instead returns once every other
+ * thread has exited; the caller then ends the process with STATUS.
+ * The address space outlives the main thread otherwise. */
+void
+process_thread_exit (int status) {
+	struct thread *cur = thread_current ();
+
+	if (cur->leader != cur) {
+		cur->exit_status = status;
+		thread_exit ();
+	}
+	wait_group (cur);
+}
+
+/* Marks the running thread's process as exiting with STATUS, so
+ * that its other threads die on their way back to user mode, and
+ * wakes those blocked in futex_wait() or process_thread_join() so
+ * that they get there.  Returns false if the process was exiting
+ * already, in which case the first status stands. */
+bool
+process_kill (int status) {
+	struct thread *leader = thread_current ()->leader;
+	bool first;
+
+	lock_acquire (&leader->group_lock);
+	first = !leader->killed;
+	if (first) {
+		leader->killed = true;
+		leader->exit_status = status;
+		cond_broadcast (&leader->group_cond, &leader->group_lock);
+	}
+	lock_release (&leader->group_lock);
+	if (first)
+		futex_cancel (&leader->killed);
+	return first;
+}
+
+/* Called on the way back to user mode.  Terminates the running
+ * thread if its process is exiting.  A thread blocked in the
+ * kernel only dies once it wakes up; process_kill() wakes the
+ * ones blocked on other threads of the process. */
+void
+process_check_killed (void) {
+	struct thread *cur = thread_current ();
+
+	if (cur->pml4 != NULL && cur->leader->killed) {
+		intr_enable ();
+		thread_exit ();
+	}
+}
+
+/* Takes the running thread, which is not the main thread of its
+ * process, out of the process.  The main thread tears down what
+ * they shared once the last of the others is gone. */
+static void
+leave_group (void) {
+	struct thread *cur = thread_current ();
+	struct thread *leader = cur->leader;
+
+	cur->fdt = NULL;
+	cur->pml4 = NULL;
+	pml4_activate (NULL);
+
+	lock_acquire (&leader->group_lock);
+	leader->group_live--;
+	sema_up (&cur->exit_sema);
+	cond_broadcast (&leader->group_cond, &leader->group_lock);
+	lock_release (&leader->group_lock);
+
+	/* Wait for a joiner, or for the main thread to let go. */
+	sema_down (&cur->free_sema);
+}
+
 /* Exit the process. This function is called by thread_exit (). */
 void
 process_exit (void) {
 	struct thread *cur = thread_current ();
+
+	if (cur->leader != cur) {
+		leave_group ();
+		return;
+	}
+	wait_group (cur);
+	release_group (cur);
+	io_ring_destroy (cur);
 	
 	// Clear fd list
 	struct file **fdt = cur->fdt;
@@ -419,6 +752,8 @@ process_cleanup (void) {
 	 * to the kernel-only page directory. */
 	pml4 = curr->pml4;
 	if (pml4 != NULL) {
+		hugepage_unregister (curr);
+
 		/* Correct ordering here is crucial.  We must set
 		 * cur->pagedir to NULL before switching page directories,
 		 * so that a timer interrupt can't switch back to the
@@ -520,6 +855,7 @@ load (const char *file_name, struct intr_frame *if_) {
 	if (t->pml4 == NULL)
 		goto done;
 	process_activate (thread_current ());
+	hugepage_register (t);
 
 	/* Open executable file. */
 	file = filesys_open (file_name);
@@ -691,6 +1027,35 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 
 	file_seek (file, ofs);
 	while (read_bytes > 0 || zero_bytes > 0) {
+		/* With -largepages, load whole 2 MB regions into large
+		 * pages, falling back to small ones if no contiguous
+		 * frames are free. */
+		if (large_user_pages && large_pg_ofs (upage) == 0
+				&& read_bytes + zero_bytes >= LARGE_PGSIZE) {
+			size_t large_read_bytes = read_bytes < LARGE_PGSIZE
+				? read_bytes : LARGE_PGSIZE;
+			uint8_t *kpage = palloc_get_multiple (PAL_USER, LARGE_PGCNT);
+
+			if (kpage != NULL) {
+				if (file_read (file, kpage, large_read_bytes)
+						!= (int) large_read_bytes) {
+					palloc_free_multiple (kpage, LARGE_PGCNT);
+					return false;
+				}
+				memset (kpage + large_read_bytes, 0,
+						LARGE_PGSIZE - large_read_bytes);
+				if (!pml4_set_large_page (thread_current ()->pml4, upage, kpage,
+							writable)) {
+					palloc_free_multiple (kpage, LARGE_PGCNT);
+					return false;
+				}
+				read_bytes -= large_read_bytes;
+				zero_bytes -= LARGE_PGSIZE - large_read_bytes;
+				upage += LARGE_PGSIZE;
+				continue;
+			}
+		}
+
 		/* Do calculate how to fill this page.
 		 * We will read PAGE_READ_BYTES bytes from FILE
 		 * and zero the final PAGE_ZERO_BYTES bytes. */
@@ -9,6 +9,10 @@
 #include "threads/flags.h"
 #include "intrinsic.h"
 #include "threads/synch.h"
+#include "threads/futex.h"
+#include "threads/mmu.h"
+#include "userprog/io-ring.h"
+#include "userprog/process.h"
 
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -41,6 +45,12 @@ struct file *get_file(int fd);
 int add_file(struct file *file);
 void remove_file(int fd);
 
+int futex_wait_user(int *uaddr, int val);
+int futex_wake_user(int *uaddr, int cnt);
+
+tid_t thread_create_user(struct intr_frame *f);
+void thread_exit_user(int status) NO_RETURN;
+
 
 /* System call.
  *
@@ -56,13 +66,15 @@ void remove_file(int fd);
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
 
 
-struct lock filesys_lock;
+/* Global lock for file operations.  Opening and reading files
+   only takes it for reading, so any number of processes may do
+   so at once; everything that changes the file system takes it
+   for writing. */
+struct rwlock filesys_lock;
 
 void
 syscall_init (void) {
-	/* global lock for file operations */
-
-	lock_init(&filesys_lock);
+	rwlock_init(&filesys_lock);
 
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48  |
 			((uint64_t)SEL_KCSEG) << 32);
@@ -181,6 +193,59 @@ syscall_handler (struct intr_frame *f UNUSED) {
 			close(fd);
 			break;
 		}
+		case SYS_FUTEX_WAIT:
+		{
+			int *uaddr = (int *) f->R.rdi;
+			int val = f->R.rsi;
+			f->R.rax = futex_wait_user(uaddr, val);
+			break;
+		}
+		case SYS_FUTEX_WAKE:
+		{
+			int *uaddr = (int *) f->R.rdi;
+			int cnt = f->R.rsi;
+			f->R.rax = futex_wake_user(uaddr, cnt);
+			break;
+		}
+		case SYS_SCHED_DEADLINE:
+		{
+			int runtime = f->R.rdi;
+			int deadline = f->R.rsi;
+			int period = f->R.rdx;
+			f->R.rax = thread_set_deadline(runtime, deadline, period);
+			break;
+		}
+		case SYS_THREAD_CREATE:
+		{
+			f->R.rax = thread_create_user(f);
+			break;
+		}
+		case SYS_THREAD_JOIN:
+		{
+			tid_t tid = f->R.rdi;
+			f->R.rax = process_thread_join(tid);
+			break;
+		}
+		case SYS_THREAD_EXIT:
+		{
+			int status = f->R.rdi;
+			thread_exit_user(status);
+			break;
+		}
+		case SYS_IO_RING_SETUP:
+		{
+			unsigned entries = f->R.rdi;
+			unsigned flags = f->R.rsi;
+			f->R.rax = (uint64_t) io_ring_setup(entries, flags);
+			break;
+		}
+		case SYS_IO_RING_ENTER:
+		{
+			unsigned to_submit = f->R.rdi;
+			unsigned min_complete = f->R.rsi;
+			f->R.rax = io_ring_enter(to_submit, min_complete);
+			break;
+		}
 		default:
 		{
 			thread_exit();
@@ -194,25 +259,37 @@ syscall_handler (struct intr_frame *f UNUSED) {
 	}
 	// printf ("system call!\n");
 	// thread_exit ();
+	process_check_killed();
 }
 
 
 
 int add_file(struct file *file) {
-	struct thread *cur = thread_current();
-	struct file **fdt = cur->fdt;
+	return add_file_to(thread_current()->leader, file);
+}
 
+/* Installs FILE in the descriptor table of the process whose main
+   thread is CUR.  The threads of a process share the table and
+   its next_fd. */
+int add_file_to(struct thread *cur, struct file *file) {
+	struct file **fdt = cur->fdt;
+	int fd;
 
+	lock_acquire(&cur->group_lock);
 	while ((cur->next_fd < FDCOUNT_LIMIT) && fdt[cur->next_fd])
 	{
 		cur->next_fd++;
 	}
-	if (cur->next_fd >= FDCOUNT_LIMIT)
+	if (cur->next_fd >= FDCOUNT_LIMIT) {
+		lock_release(&cur->group_lock);
 		return -1;
+	}
 
 	fdt[cur->next_fd] = file;
+	fd = cur->next_fd;
+	lock_release(&cur->group_lock);
 	
-	return cur->next_fd;
+	return fd;
 }
 
 void remove_file(int fd) {
@@ -238,8 +315,9 @@ void halt(){
 
 
 void exit(int status) {
-	thread_current()->exit_status = status;
-	printf("%s: exit(%d)\n", thread_name(), status);
+	/* Only the first thread of a process to exit() reports it. */
+	if (process_kill(status))
+		printf("%s: exit(%d)\n", thread_name(), status);
 	thread_exit();
 }
 
@@ -304,19 +382,21 @@ bool remove(const char *file) {
 
 /* open file corresponds to path in "file" */
 int open(const char *file) { 
+	struct rw_hold hold;
+
 	validate_address(file);
 	/* Acquire global lock */
-	lock_acquire(&filesys_lock);
+	rwlock_acquire_read(&filesys_lock, &hold);
 
 	struct thread *t = thread_current();
 	if (strcmp(file, "") == 0){
-		lock_release(&filesys_lock);
+		rwlock_release_read(&filesys_lock, &hold);
 		return -1;
 	}
 	struct file *file_ptr = filesys_open(file);
 
 	if (file_ptr == NULL) {
-		lock_release(&filesys_lock);
+		rwlock_release_read(&filesys_lock, &hold);
 		return -1;
 	}
 
@@ -328,7 +408,7 @@ int open(const char *file) {
 	}
 	
 	/* Release global lock */
-	lock_release(&filesys_lock);
+	rwlock_release_read(&filesys_lock, &hold);
 
 	return fd;
 }
@@ -336,11 +416,11 @@ int open(const char *file) {
 /* close file corresponds to file descriptor fd */
 void close(int fd) {
 	/* Acquire global lock */
-	lock_acquire(&filesys_lock);
+	rwlock_acquire_write(&filesys_lock);
 	struct file *file_ptr = thread_current()->fdt[fd];
 
 	if (file_ptr == NULL){
-		lock_release(&filesys_lock);
+		rwlock_release_write(&filesys_lock);
 		return -1;
 	}
 
@@ -348,7 +428,7 @@ void close(int fd) {
 	remove_file(fd);
 	
 
-	lock_release(&filesys_lock);
+	rwlock_release_write(&filesys_lock);
 	return 0;
 }
 
@@ -359,7 +439,9 @@ int read(int fd, void *buffer, unsigned size) {
 	// otherwise reads from file using file_read() function
 
 	validate_address(buffer);
-	lock_acquire(&filesys_lock);
+	/* file_read() advances the position shared by every thread of
+	   the process, so reads through an fd exclude each other. */
+	rwlock_acquire_write(&filesys_lock);
 	off_t read_size = 0;
 	char *read_buffer = (char *)buffer;
 
@@ -373,18 +455,18 @@ int read(int fd, void *buffer, unsigned size) {
 			read_size++;
 		}
 		read_buffer[read_size]='\0';
-		lock_release(&filesys_lock);
+		rwlock_release_write(&filesys_lock);
 		return read_size;
 	}
 
 	else{
 		struct file *file_ptr = get_file(fd);
 		if (file_ptr == NULL){
-			lock_release(&filesys_lock);
+			rwlock_release_write(&filesys_lock);
 			return -1;
 		}
 		read_size = file_read(file_ptr, read_buffer, size);
-		lock_release(&filesys_lock);
+		rwlock_release_write(&filesys_lock);
 		return read_size;
 	}
 }
@@ -395,24 +477,24 @@ int write(int fd, const void *buffer, unsigned size) {
 	// If fd is 1, it write to the console using putbuf(), 
 	// otherwise write to the file using file_write() function
 	validate_address(buffer);
-	lock_acquire(&filesys_lock);
+	rwlock_acquire_write(&filesys_lock);
 	off_t written_size = 0;
 	char *write_buffer = (char *)buffer;
 
 	/* STDOUT */
 	if (fd == 1) {
 		putbuf(write_buffer, size);
-		lock_release(&filesys_lock);
+		rwlock_release_write(&filesys_lock);
 		return size;
 	}
 	else {
 		struct file *file_ptr = get_file(fd);
 		if (file_ptr == NULL){
-			lock_release(&filesys_lock);
+			rwlock_release_write(&filesys_lock);
 			return -1;
 		}
 		written_size = file_write(file_ptr, write_buffer, size);
-		lock_release(&filesys_lock);
+		rwlock_release_write(&filesys_lock);
 		return written_size;
 	}
 }
@@ -433,19 +515,67 @@ void seek(int fd, unsigned position) {
 	if (fd < 2 || fd > FDCOUNT_LIMIT){
 		return;
 	}
+	rwlock_acquire_write(&filesys_lock);
 	struct file *file_ptr = get_file(fd);
 	
-	if (file_ptr == NULL){
-		return;
+	if (file_ptr != NULL){
+		file_seek(file_ptr, position);
 	}
-	file_seek(file_ptr, position);
+	rwlock_release_write(&filesys_lock);
 }
 
 unsigned tell(int fd) {
 	if (fd < 2 || fd > FDCOUNT_LIMIT){
 		return;
 	}
+	rwlock_acquire_write(&filesys_lock);
 	struct file *file_ptr = get_file(fd);
+	unsigned position = file_ptr != NULL ? file_tell(file_ptr) : 0;
+	rwlock_release_write(&filesys_lock);
+
+	return position;
+}
 
-	return file_tell(file_ptr);
-}
\ No newline at end of file
+/* Returns the kernel address of the futex word at user address
+   UADDR, which keys the futex by physical frame, or terminates
+   the process if UADDR is not an aligned, mapped user address. */
+static int *futex_kaddr(int *uaddr) {
+	if ((uint64_t) uaddr % sizeof (int) != 0)
+		exit(-1);
+	validate_address(uaddr);
+	return pml4_get_page(thread_current()->pml4, uaddr);
+}
+
+/* Sleeps until woken if *uaddr == val.  Returns 0 after sleeping,
+   or -1 at once if *uaddr had some other value or if the process
+   is being killed. */
+int futex_wait_user(int *uaddr, int val) {
+	const bool *killed = &thread_current()->leader->killed;
+
+	if (!futex_wait(futex_kaddr(uaddr), val, killed) || *killed)
+		return -1;
+	return 0;
+}
+
+/* Wakes up to cnt threads sleeping on uaddr and returns how many
+   were woken. */
+int futex_wake_user(int *uaddr, int cnt) {
+	if (cnt <= 0)
+		return 0;
+	return futex_wake(futex_kaddr(uaddr), cnt);
+}
+
+/* Starts a thread at the user function in rdi with the arguments
+   in rsi and rdx; lib/user passes a stub that calls the thread
+   function and then thread_exit(). */
+tid_t thread_create_user(struct intr_frame *f) {
+	return process_thread_create(f, (void *) f->R.rdi, (void *) f->R.rsi,
+			(void *) f->R.rdx);
+}
+
+/* Ends the calling thread.  The main thread first waits for the
+   others, then ends the process. */
+void thread_exit_user(int status) {
+	process_thread_exit(status);
+	exit(status);
+}